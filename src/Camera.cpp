@@ -16,6 +16,16 @@ void Camera::SetViewPort(ID3D11DeviceContext* context) const
 	context->RSSetViewports(1, &m_Viewport);
 }
 
+Vector3 Camera::GetPosition() const
+{
+	return m_Position;
+}
+
+float Camera::GetFov() const
+{
+	return m_Fov;
+}
+
 void Camera::Update(const ImGuiIO& io)
 {
     m_AspectRatio = io.DisplaySize.x / io.DisplaySize.y;
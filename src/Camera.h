@@ -9,6 +9,8 @@ class Camera
 public:
 	[[nodiscard]] DirectX::SimpleMath::Matrix GetViewProjectionMatrix() const;
 	void SetViewPort(ID3D11DeviceContext* context) const;
+	[[nodiscard]] DirectX::SimpleMath::Vector3 GetPosition() const;
+	[[nodiscard]] float GetFov() const;
 	void Update(const ImGuiIO& io);
 
 private:
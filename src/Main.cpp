@@ -4,16 +4,29 @@
 
 
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <glm/gtx/normal.hpp>
 
 #include "base.h"
+#include "chunk.h"
 #include "imgui_impl_dx11.h"
 #include "imgui_impl_win32.h"
 #include "MeshRenderer.h"
 #include "Camera.h"
 #include "heightmap.h"
+#include "lod.h"
+#include "meshbuffer.h"
+#include "meshlet.h"
+#include "ordering.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "progressive.h"
+#include "quantized.h"
 #include "stl.h"
+#include "terrain.h"
+#include "tiles.h"
+#include "trace.h"
 
 #include "Texture2D.h"
 #include "triangulator.h"
@@ -98,8 +111,13 @@ int main(int, char**)
     std::string inFile = "";
     char filePath[256] {};
     const std::string outFile = "terrain.stl";
+    const std::string quantizedFile = "terrain.qmesh"; // 16-bit quantized vertices, no base
+    const std::string progressiveFile = "terrain.pmesh"; // points in insertion order, any prefix is a mesh
     const std::string normalmapPath = "normalMap.png"; // path to write normal map png
     const std::string shadePath = "hillShade.png"; // path to write hillshade png
+    const std::string derivativesPrefix = "terrain"; // prefix of the slope, aspect and curvature .f32 rasters
+    const std::string tracePath = "trace.json"; // path to write chrome trace json
+    const std::string tileDir = "tiles"; // directory to write the tile pyramid to
     float zScale = 30.0f;	// z scale relative to x & y
     float zExaggeration = 1.0f;	// z exaggeration
     float maxError = 1.0f;	// maximum triangulation error
@@ -114,18 +132,41 @@ int main(int, char**)
     float borderHeight = 1; // border z height
     float shadeAlt = 45; // hillshade light altitude
     float shadeAz = 0; //hillshade light azimuth
+    int threads = 0; // triangulator threads, 0 for one per core
+    bool deterministic = false; // stable tie-breaking for reproducible meshes
+    bool verifyDeterminism = false; // on RUN, check that 1..cores threads give the same mesh
+    std::string determinismStats = "";
+    bool meshlets = false; // on RUN, cluster the mesh into meshlets and check them
+    const int meshletVertices = 64;
+    const int meshletTriangles = 124;
+    std::string meshletStats = "";
+    bool trace = false; // record each INIT, STEP, REVERSE or RUN to a chrome trace, replacing the last one
+    bool optimizeOrder = true; // reorder output triangles for the vertex cache
+    bool chunked = false; // render as chunks with 16-bit index buffers
+    bool tiles = false; // write a quantized-mesh tile pyramid with the other output files
+    int tileZoom = 4; // deepest tile pyramid level
+    bool viewLod = false; // view-dependent level of detail around the camera
+    float lodTolerance = 1.0f; // screen-space error tolerance in pixels
+    std::string lodStats = "";
+    bool replayLod = false; // on RUN, time LOD selection along a synthetic flight without rendering
+    const int replayFrames = 600;
+    std::string replayStats = "";
+    std::string orderStats = "";
     std::string stats = "null";
     std::string gridStats = "null";
     bool outputFiles = false;
 
     std::shared_ptr<Heightmap> hm = nullptr;
     std::shared_ptr<Triangulator> tri = nullptr;
+    MeshBuffer meshBuffer;
+    std::unique_ptr<LodSelector> lod = nullptr;
 
     float morphTarget = 1.0f;
 
     // Main loop
     bool done = false;
     bool grid = false;
+    bool gridBilinear = false;
     while (!done)
     {
         // Poll and handle messages (inputs, window resize, etc.)
@@ -162,9 +203,25 @@ int main(int, char**)
         ImGui::InputFloat("gamma curve exponent", &gamma);
         ImGui::InputInt("border size in pixels", &borderSize);
         ImGui::InputFloat("border z height", &borderHeight);
-        ImGui::Checkbox("output hillshade and normal", &outputFiles);
+        ImGui::Checkbox("output hillshade, normal, slope and curvature", &outputFiles);
         ImGui::InputFloat("hillshade light altitude", &shadeAlt);
         ImGui::InputFloat("hillshade light azimuth", &shadeAz);
+        ImGui::InputInt("triangulator threads", &threads);
+        ImGui::Checkbox("deterministic", &deterministic);
+        ImGui::SameLine();
+        ImGui::Checkbox("verify on RUN", &verifyDeterminism);
+        ImGui::Checkbox("record trace", &trace);
+        ImGui::Checkbox("optimize vertex cache order", &optimizeOrder);
+        ImGui::Checkbox("16-bit index chunks", &chunked);
+        ImGui::SameLine();
+        ImGui::Checkbox("meshlets", &meshlets);
+        ImGui::Checkbox("tile pyramid", &tiles);
+        ImGui::SameLine();
+        ImGui::InputInt("deepest tile level", &tileZoom);
+        const bool lodToggled = ImGui::Checkbox("view-dependent LOD", &viewLod);
+        ImGui::SameLine();
+        ImGui::InputFloat("pixel tolerance", &lodTolerance);
+        ImGui::Checkbox("replay LOD flight on RUN", &replayLod);
         bool init = ImGui::Button("INIT");
         ImGui::SameLine();
         bool step = io.KeysDown[ImGui::GetKeyIndex(ImGuiKey_RightArrow)] ||
@@ -175,10 +232,18 @@ int main(int, char**)
         bool run = ImGui::Button("RUN");
         bool morph = ImGui::DragFloat("collapse target", &morphTarget, 0.0005f, 0.0f, 1.0f);
         ImGui::Checkbox("grid", &grid);
+        ImGui::SameLine();
+        ImGui::Checkbox("bilinear", &gridBilinear);
         if (grid) ImGui::Text(gridStats.c_str());
         else ImGui::Text(stats.c_str());
+        if (viewLod) ImGui::Text(lodStats.c_str());
         ImGui::End();
 
+        // every recording ends in the frame it started in, whichever way the frame goes
+        const bool traced = trace && (init || step || reverse || run);
+        if (traced)
+            Trace::Begin();
+
         if (init)
         {
             morphTarget = 1.0f;
@@ -189,29 +254,40 @@ int main(int, char**)
             int h = hm->Height();
             if (w * h == 0)
             {
-                stats = "invalid heightmap file (try png, jpg, etc.)";
+                stats = "invalid heightmap file (try png, jpg, r16 or f32 with a .hdr)";
+                if (traced)
+                    Trace::End(tracePath);
                 continue;
             }
+            hm->SetThreadCount(threads);
+
+            // preprocess heightmap, fusing the pointwise ops into as few passes as possible.
+            // without a blur, leveling, inverting and the gamma curve become one table
+            // lookup per 16-bit code, the Heightmap ops would lose the codes at AutoLevel
+            HeightmapPipeline pipeline;
 
             // auto level heightmap
             if (level)
-                hm->AutoLevel();
+                pipeline.AutoLevel();
 
             // invert heightmap
             if (invert)
-                hm->Invert();
+                pipeline.Invert();
 
             // blur heightmap
             if (blurSigma > 0)
-                hm->GaussianBlur(blurSigma);
+                pipeline.GaussianBlur(blurSigma);
 
             // apply gamma curve
             if (gamma > 0)
-                hm->GammaCurve(gamma);
+                pipeline.GammaCurve(gamma);
 
             // add border
             if (borderSize > 0)
-                hm->AddBorder(borderSize, borderHeight);
+                pipeline.AddBorder(borderSize, borderHeight);
+
+            pipeline.SetThreadCount(threads);
+            pipeline.Apply(*hm);
 
             // get updated size
             w = hm->Width();
@@ -219,66 +295,199 @@ int main(int, char**)
 
             // triangulate
             tri = std::make_shared<Triangulator>(hm, maxError / 1000.0f, maxTriangles, maxPoints);
+            tri->SetThreadCount(threads);
+            tri->SetDeterministic(deterministic);
             tri->Initialize();
         }
 
         if (step && tri) tri->RunStep();
         if (reverse && tri) tri->ReverseStep();
-        if (morph && tri) tri->Morph(morphTarget);
 
         if (run && tri)
         {
             tri->Run();
 
+            // repeat the triangulation with every thread count up to the core count
+            determinismStats = "";
+            if (verifyDeterminism)
+            {
+                const int maxThreads = DefaultThreadCount();
+                const bool same = VerifyDeterminism(hm, maxError / 1000.0f, maxTriangles, maxPoints, maxThreads);
+                determinismStats = "1.." + std::to_string(maxThreads) + " threads " +
+                    (same ? "identical" : "DIFFER") + "\n";
+            }
+
+            // select along a fixed flight with the current viewport and tolerance
+            replayStats = "";
+            if (replayLod)
+            {
+                const float pixelScale = io.DisplaySize.y / (2.0f * std::tan(g_Camera->GetFov() * 0.5f));
+                const std::vector<glm::vec3> eyes = LodFlightPath(
+                    hm->Width(), hm->Height(), zScale * zExaggeration, replayFrames);
+                const std::vector<LodFrameStats> frames = ReplayLodPath(
+                    *tri, zScale * zExaggeration, eyes, pixelScale, lodTolerance);
+                double total = 0;
+                double slowest = 0;
+                for (const LodFrameStats& frame : frames)
+                {
+                    total += frame.Milliseconds;
+                    if (frame.Milliseconds > slowest)
+                        slowest = frame.Milliseconds;
+                }
+                replayStats = std::to_string(frames.size()) + " LOD frames " +
+                    std::to_string(total / frames.size()) + " ms avg " +
+                    std::to_string(slowest) + " ms max\n";
+            }
+
             auto points = tri->Points(zScale * zExaggeration);
             auto triangles = tri->Triangles();
 
-            // add base
+            // cluster before the base and reordering, which the halfedges don't cover
+            meshletStats = "";
+            if (meshlets)
+            {
+                const Meshlets ml = BuildMeshlets(
+                    points, tri->TriangleIndices(), tri->Halfedges(), meshletVertices, meshletTriangles);
+                const bool valid = VerifyMeshlets(ml, tri->TriangleIndices(), meshletVertices, meshletTriangles);
+                meshletStats = std::to_string(ml.Clusters.size()) + " meshlets " +
+                    (valid ? "valid" : "INVALID") + "\n";
+            }
+
+            // add base, before reordering so the hull indices still match the points
             if (baseHeight > 0)
             {
                 const float z = -baseHeight * zScale * zExaggeration;
                 int w = hm->Width();
                 int h = hm->Height();
-                AddBase(points, triangles, w, h, z);
+                AddBaseFromHull(points, triangles, tri->Hull(), w, h, z);
+            }
+
+            // reorder for the post-transform vertex cache
+            orderStats = "";
+            if (optimizeOrder)
+            {
+                const OrderingStats os = OptimizeMeshOrder(points, triangles, 16);
+                orderStats =
+                    "ACMR " + std::to_string(os.Before.Acmr) + " -> " + std::to_string(os.After.Acmr) + "\n" +
+                    "ATVR " + std::to_string(os.Before.Atvr) + " -> " + std::to_string(os.After.Atvr) + "\n";
             }
 
             if (outputFiles)
             {
                 SaveBinarySTL(outFile, points, triangles);
+                SaveQuantizedMesh(quantizedFile, QuantizeMesh(*tri, zScale * zExaggeration));
+                SaveProgressiveMesh(progressiveFile, *tri);
+                if (tiles)
+                {
+                    TilePyramidOptions options;
+                    options.MaxZoom = tileZoom;
+                    options.MaxError = maxError / 1000.0f;
+                    options.Threads = threads;
+                    BuildTilePyramid(*hm, tileDir, options);
+                }
                 hm->SaveNormalmap(normalmapPath, zScale * zExaggeration);
                 hm->SaveHillshade(shadePath, zScale * zExaggeration, shadeAlt, shadeAz);
+                hm->ReleaseNormalmap();
+
+                // per-pixel slope, aspect and curvatures from one pass over the heights
+                TerrainOptions terrain;
+                terrain.ZScale = zScale * zExaggeration;
+                terrain.Slope = true;
+                terrain.Aspect = true;
+                terrain.ProfileCurvature = true;
+                terrain.PlanCurvature = true;
+                terrain.Threads = threads;
+                SaveTerrainDerivatives(derivativesPrefix, ComputeTerrainDerivatives(*hm, terrain));
             }
         }
 
-        if (tri && (run || init || step || reverse || morph))
-        {
-            auto points = tri->Points(zScale * zExaggeration);
-            auto triangles = tri->Triangles();
+        if (traced)
+            Trace::End(tracePath);
 
+        if (tri && morphTarget < 1.0f && (morph || step || reverse || run)) tri->Morph(morphTarget);
 
-            if (!points.empty())
+        if (tri && (run || init || step || reverse || morph || lodToggled))
+        {
+            if (morphTarget < 1.0f || chunked)
+            {
+                const auto points = morphTarget < 1.0f ?
+                    tri->MorphPoints(zScale * zExaggeration) :
+                    tri->Points(zScale * zExaggeration);
+                if (chunked)
+                {
+                    g_MeshRenderer->SetChunks(SplitMeshChunks(points, tri->Triangles(), 65535));
+                }
+                else
+                {
+                    const auto& [vb, ib] = CreateTerrainMesh(points, tri->Triangles());
+                    g_MeshRenderer->SetVerticesAndIndices(vb, ib);
+                }
+                meshBuffer.Invalidate();
+            }
+            else
             {
-                const auto& [vb, ib] = CreateTerrainMesh(points, triangles);
-                g_MeshRenderer->SetVerticesAndIndices(vb, ib);
+                // only new vertices and rewritten triangle slots are uploaded
+                meshBuffer.Update(*tri, zScale * zExaggeration);
+                g_MeshRenderer->UpdateMesh(g_pd3dDeviceContext, meshBuffer);
             }
 
             if (run)
             {
-                auto [pointsGrid, trianglesGrid] = tri->MeshGrid(zScale * zExaggeration);
-                const auto& [vbg, ibg] = CreateTerrainMesh(pointsGrid, trianglesGrid);
+                const GridMesh gridMesh = tri->MeshGrid(zScale * zExaggeration, gridBilinear);
+                const auto& [vbg, ibg] = CreateTerrainMesh(gridMesh.Points, *gridMesh.Triangles);
                 g_MeshRenderer->SetVerticesAndIndicesNaive(vbg, ibg);
 
-                gridStats = "grid: " + std::to_string(trianglesGrid.size()) + " triangles" + "\n" +
-                    std::to_string(pointsGrid.size()) + " vertices" + "\n";
+                gridStats = "grid: " + std::to_string(gridMesh.Triangles->size()) + " triangles" + "\n" +
+                    std::to_string(gridMesh.Points.size()) + " vertices" + "\n";
             }
 
             // display statistics
             const int naiveTriangleCount = (hm->Width() - 1) * (hm->Height() - 1) * 2;
             stats =
-                std::to_string(triangles.size()) + " triangles" + "\n" +
-                std::to_string(points.size()) + " vertices" + "\n" +
+                std::to_string(tri->NumTriangles()) + " triangles" + "\n" +
+                std::to_string(tri->NumPoints()) + " vertices" + "\n" +
                 std::to_string(tri->Error()) + " error" + "\n" +
-                std::to_string(100.f * triangles.size() / naiveTriangleCount) + "%% vs. naive\n";
+                std::to_string(100.f * tri->NumTriangles() / naiveTriangleCount) + "%% vs. naive\n";
+            stats += orderStats;
+            stats += determinismStats;
+            stats += meshletStats;
+            stats += replayStats;
+#if HMM_ENABLE_STATS
+            const TriangulatorStats& ts = tri->Stats();
+            stats +=
+                std::to_string(ts.PixelsRasterized) + " pixels rasterized\n" +
+                std::to_string(ts.Flips) + " flips\n" +
+                std::to_string(ts.CollinearSplits) + " collinear splits\n" +
+                std::to_string(ts.HeapPushes) + "/" + std::to_string(ts.HeapPops) + "/" +
+                std::to_string(ts.HeapRemoves) + " heap push/pop/remove\n" +
+                std::to_string(ts.StepNs / 1000000.0) + " ms step\n" +
+                std::to_string(ts.FlushNs / 1000000.0) + " ms flush\n" +
+                std::to_string(ts.LegalizeNs / 1000000.0) + " ms legalize\n";
+#endif
+        }
+
+        // the selector follows the finished triangulation, rebuilt after every change to it
+        if (tri && (run || init || step || reverse || morph || lodToggled))
+            lod = viewLod ? std::make_unique<LodSelector>(*tri, zScale * zExaggeration) : nullptr;
+
+        if (lod)
+        {
+            const auto position = g_Camera->GetPosition();
+            const glm::vec3 eye(position.x, position.z, position.y);
+            const float pixelScale = io.DisplaySize.y / (2.0f * std::tan(g_Camera->GetFov() * 0.5f));
+            const LodFrameStats& ls = lod->Select(eye, pixelScale, lodTolerance);
+            // the selector's points are uploaded once, after that only the triangle
+            // slots this Select() rewrote. the triangulation path above always
+            // resets meshBuffer in the frame the selector is rebuilt
+            if (meshBuffer.Update(*lod) || ls.Activated + ls.Deactivated > 0)
+            {
+                g_MeshRenderer->UpdateMesh(g_pd3dDeviceContext, meshBuffer);
+            }
+            lodStats =
+                std::to_string(ls.ActivePoints) + " active vertices\n" +
+                std::to_string(ls.Triangles) + " triangles\n" +
+                "+" + std::to_string(ls.Activated) + " -" + std::to_string(ls.Deactivated) + " vertices\n" +
+                std::to_string(ls.Milliseconds) + " ms select\n";
         }
 
         // Rendering
@@ -1,9 +1,33 @@
 #include "MeshRenderer.h"
+#include <algorithm>
 #include <d3dcompiler.h>
 #include "D3DHelper.h"
 
 using namespace DirectX;
 
+namespace
+{
+    void UploadRange(ID3D11DeviceContext* context, ID3D11Buffer* buffer,
+        const void* data, const UINT stride, const DirtyRange range)
+    {
+        const D3D11_BOX box = { range.Begin * stride, 0, 0, range.End * stride, 1, 1 };
+        context->UpdateSubresource(buffer, 0, &box,
+            static_cast<const uint8_t*>(data) + range.Begin * stride, 0, 0);
+    }
+
+    // returns true if the buffer had to be recreated to hold count elements
+    bool Reserve(ID3D11Device* device, Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer,
+        uint32_t& capacity, const uint32_t count, const UINT stride, const UINT bindFlags)
+    {
+        if (buffer && count <= capacity) return false;
+
+        capacity = std::max(count, capacity * 2);
+        const CD3D11_BUFFER_DESC desc(capacity * stride, bindFlags, D3D11_USAGE_DEFAULT);
+        ThrowIfFailed(device->CreateBuffer(&desc, nullptr, buffer.ReleaseAndGetAddressOf()));
+        return true;
+    }
+}
+
 MeshRenderer::MeshRenderer(ID3D11Device* device, const std::shared_ptr<PassConstants>& constants) :
     Renderer(device), m_Cb0(device), m_Constants(constants) {}
 
@@ -50,9 +74,6 @@ void MeshRenderer::Render(ID3D11DeviceContext* context)
     constexpr UINT stride = sizeof(Vertex);
     constexpr UINT offset = 0;
     context->IASetInputLayout(m_InputLayout.Get());
-    const auto vb = m_VertexBuffer.Get();
-    context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
-    context->IASetIndexBuffer(m_IndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
     context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     const auto cb0 = m_Cb0.GetBuffer();
@@ -62,6 +83,22 @@ void MeshRenderer::Render(ID3D11DeviceContext* context)
     context->PSSetShader(m_Ps.Get(), nullptr, 0);
     context->OMSetBlendState(s_CommonStates->Opaque(), nullptr, 0xffffffff);
     context->OMSetDepthStencilState(s_CommonStates->DepthDefault(), 0);
+
+    if (!m_Chunks.empty())
+    {
+        for (const ChunkBuffers& chunk : m_Chunks)
+        {
+            const auto vb = chunk.VertexBuffer.Get();
+            context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+            context->IASetIndexBuffer(chunk.IndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+            context->DrawIndexed(chunk.IndexCount, 0, 0);
+        }
+        return;
+    }
+
+    const auto vb = m_VertexBuffer.Get();
+    context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+    context->IASetIndexBuffer(m_IndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
     context->DrawIndexed(m_IndexCount, 0, 0);
 }
 
@@ -97,7 +134,9 @@ void MeshRenderer::UpdateBuffer(ID3D11DeviceContext* context)
 
 void MeshRenderer::SetVerticesAndIndices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
 {
+    m_Chunks.clear();
     m_VertexCount = static_cast<uint32_t>(vertices.size());
+    m_VertexCapacity = m_VertexCount;
     ThrowIfFailed(DirectX::CreateStaticBuffer<Vertex>(
         m_Device,
         vertices.data(),
@@ -106,6 +145,7 @@ void MeshRenderer::SetVerticesAndIndices(const std::vector<Vertex>& vertices, co
         m_VertexBuffer.ReleaseAndGetAddressOf()));
 
     m_IndexCount = static_cast<uint32_t>(indices.size());
+    m_IndexCapacity = m_IndexCount;
     ThrowIfFailed(DirectX::CreateStaticBuffer<uint32_t>(
         m_Device,
         indices.data(),
@@ -135,3 +175,63 @@ void MeshRenderer::SetVerticesAndIndicesNaive(
         m_IndexBufferGrid.ReleaseAndGetAddressOf()));
     m_Loaded = true;
 }
+
+void MeshRenderer::UpdateMesh(ID3D11DeviceContext* context, const MeshBuffer& mesh)
+{
+    static_assert(sizeof(Vertex) == sizeof(glm::vec3), "MeshBuffer vertices must match Vertex");
+
+    const auto& vertices = mesh.Vertices();
+    const auto& indices = mesh.Indices();
+    if (vertices.empty()) return;
+
+    m_Chunks.clear();
+    m_VertexCount = static_cast<uint32_t>(vertices.size());
+    if (Reserve(m_Device, m_VertexBuffer, m_VertexCapacity, m_VertexCount, sizeof(Vertex), D3D11_BIND_VERTEX_BUFFER))
+        UploadRange(context, m_VertexBuffer.Get(), vertices.data(), sizeof(Vertex), { 0, static_cast<int>(m_VertexCount) });
+    else if (!mesh.DirtyVertices().Empty())
+        UploadRange(context, m_VertexBuffer.Get(), vertices.data(), sizeof(Vertex), mesh.DirtyVertices());
+
+    m_IndexCount = static_cast<uint32_t>(indices.size());
+    if (Reserve(m_Device, m_IndexBuffer, m_IndexCapacity, m_IndexCount, sizeof(uint32_t), D3D11_BIND_INDEX_BUFFER))
+        UploadRange(context, m_IndexBuffer.Get(), indices.data(), sizeof(uint32_t), { 0, static_cast<int>(m_IndexCount) });
+    else
+        for (const DirtyRange& range : mesh.DirtyIndices())
+            UploadRange(context, m_IndexBuffer.Get(), indices.data(), sizeof(uint32_t), range);
+
+    m_Loaded = true;
+}
+
+void MeshRenderer::SetChunks(const std::vector<MeshChunk>& chunks)
+{
+    std::vector<ChunkBuffers> buffers;
+    buffers.reserve(chunks.size());
+    std::vector<Vertex> vertices;
+    for (const MeshChunk& chunk : chunks)
+    {
+        if (chunk.Indices.empty()) continue;
+
+        // same y-up swap as CreateTerrainMesh
+        vertices.clear();
+        vertices.reserve(chunk.Vertices.size());
+        for (const glm::vec3& p : chunk.Vertices)
+            vertices.emplace_back(XMFLOAT3(p.x, p.z, p.y));
+
+        ChunkBuffers b;
+        b.IndexCount = static_cast<uint32_t>(chunk.Indices.size());
+        ThrowIfFailed(DirectX::CreateStaticBuffer<Vertex>(
+            m_Device,
+            vertices.data(),
+            vertices.size(),
+            D3D11_BIND_VERTEX_BUFFER,
+            b.VertexBuffer.ReleaseAndGetAddressOf()));
+        ThrowIfFailed(DirectX::CreateStaticBuffer<uint16_t>(
+            m_Device,
+            chunk.Indices.data(),
+            chunk.Indices.size(),
+            D3D11_BIND_INDEX_BUFFER,
+            b.IndexBuffer.ReleaseAndGetAddressOf()));
+        buffers.push_back(std::move(b));
+    }
+    m_Chunks = std::move(buffers);
+    m_Loaded = true;
+}
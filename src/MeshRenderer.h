@@ -4,6 +4,8 @@
 #include <directxtk/VertexTypes.h>
 
 #include "Renderer.h"
+#include "chunk.h"
+#include "meshbuffer.h"
 
 using Vertex = DirectX::VertexPosition;
 
@@ -24,6 +26,11 @@ public:
 
     void SetVerticesAndIndices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
     void SetVerticesAndIndicesNaive(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+    // upload only the dirty ranges of mesh, buffers are recreated when they run out of capacity
+    void UpdateMesh(ID3D11DeviceContext* context, const MeshBuffer& mesh);
+    // replace the mesh by one static vertex buffer and 16-bit index buffer per chunk.
+    // chunk vertices are in the z-up layout of Triangulator::Points
+    void SetChunks(const std::vector<MeshChunk>& chunks);
 
 protected:
     void UpdateBuffer(ID3D11DeviceContext* context) override;
@@ -41,7 +48,18 @@ protected:
     std::shared_ptr<PassConstants> m_Constants = nullptr;
     uint32_t m_VertexCount = 0;
     uint32_t m_IndexCount = 0;
+    uint32_t m_VertexCapacity = 0;
+    uint32_t m_IndexCapacity = 0;
     bool m_Loaded = false;
 
     uint32_t m_IndexCountGrid = 0;
+
+    struct ChunkBuffers
+    {
+        Microsoft::WRL::ComPtr<ID3D11Buffer> VertexBuffer;
+        Microsoft::WRL::ComPtr<ID3D11Buffer> IndexBuffer;
+        uint32_t IndexCount = 0;
+    };
+    // drawn instead of m_VertexBuffer/m_IndexBuffer while not empty
+    std::vector<ChunkBuffers> m_Chunks;
 };
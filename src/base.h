@@ -3,7 +3,11 @@
 #include <glm/glm.hpp>
 #include <vector>
 
-void AddBase(
+// close the mesh into a solid with a flat bottom at height z: a wall under every
+// boundary edge and a fan around the base center. hull is the boundary point
+// indices in walk order (Triangulator::Hull), so this is O(boundary)
+void AddBaseFromHull(
     std::vector<glm::vec3> &points,
     std::vector<glm::ivec3> &triangles,
+    const std::vector<int> &hull,
     const int w, const int h, const float z);
@@ -1,12 +1,19 @@
 #include "blur.h"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <fstream>
+
+#include "parallel.h"
+#include "trace.h"
 
 // see: http://blog.ivank.net/fastest-gaussian-blur.html
 
 namespace {
 
-std::vector<int> BoxesForGaussian(const float sigma, const int n) {
+std::array<int, 3> BoxesForGaussian(const float sigma) {
+    const int n = 3;
     const float wIdeal = std::sqrt((12 * sigma * sigma / n) + 1);
     int wl = wIdeal;
     if (wl % 2 == 0) {
@@ -19,111 +26,284 @@ std::vector<int> BoxesForGaussian(const float sigma, const int n) {
         (-4 * wl - 4);
     const int m = std::round(mIdeal);
 
-    std::vector<int> sizes;
+    std::array<int, 3> sizes;
     for (int i = 0; i < n; i++) {
-        sizes.push_back(i < m ? wl : wu);
+        sizes[i] = i < m ? wl : wu;
     }
     return sizes;
 }
 
+// columns the vertical pass runs over together, so every row step reads and
+// writes contiguous spans instead of striding down a single column
+constexpr int BlockSize = 256;
+
 void BoxBlurH(
-    std::vector<float> &src,
-    std::vector<float> &dst,
-    const int w, const int h, const int r)
+    const float *src, float *dst,
+    const int w, const int h, const int r, const int threads)
 {
     const float m = 1.f / (r + r + 1);
-    for (int i = 0; i < h; i++) {
-        int ti = i * w;
-        int li = ti;
-        int ri = ti + r;
-        float fv = src[ti];
-        float lv = src[ti + w - 1];
-        float val = (r + 1) * fv;
-        for (int j = 0; j < r; j++) {
-            val += src[ti + j];
-        }
-        for (int j = 0; j <= r; j++) {
-            val += src[ri] - fv;
-            dst[ti] = val * m;
-            ri++;
-            ti++;
-        }
-        for (int j = r + 1; j < w - r; j++) {
-            val += src[ri] - src[li];
-            dst[ti] = val * m;
-            li++;
-            ri++;
-            ti++;
-        }
-        for (int j = w - r; j < w; j++) {
-            val += lv - src[li];
-            dst[ti] = val * m;
-            li++;
-            ti++;
+    ParallelFor(h, threads, [&](const int y0, const int y1) {
+        for (int i = y0; i < y1; i++) {
+            int ti = i * w;
+            int li = ti;
+            int ri = ti + r;
+            float fv = src[ti];
+            float lv = src[ti + w - 1];
+            float val = (r + 1) * fv;
+            for (int j = 0; j < r; j++) {
+                val += src[ti + j];
+            }
+            for (int j = 0; j <= r; j++) {
+                val += src[ri] - fv;
+                dst[ti] = val * m;
+                ri++;
+                ti++;
+            }
+            for (int j = r + 1; j < w - r; j++) {
+                val += src[ri] - src[li];
+                dst[ti] = val * m;
+                li++;
+                ri++;
+                ti++;
+            }
+            for (int j = w - r; j < w; j++) {
+                val += lv - src[li];
+                dst[ti] = val * m;
+                li++;
+                ti++;
+            }
         }
-    }
+    });
 }
 
 void BoxBlurV(
-    std::vector<float> &src,
-    std::vector<float> &dst,
-    const int w, const int h, const int r)
+    const float *src, float *dst,
+    const int w, const int h, const int r, const int threads)
 {
+    // the same running sums as walking one column at a time, kept for a block
+    // of columns at once. each column still sees the same float operations in
+    // the same order, so the result is bit-identical
     const float m = 1.f / (r + r + 1);
-    for (int i = 0; i < w; i++) {
-        int ti = i;
-        int li = ti;
-        int ri = ti + r * w;
-        float fv = src[ti];
-        float lv = src[ti + w * (h - 1)];
-        float val = (r + 1) * fv;
-        for (int j = 0; j < r; j++) {
-            val += src[ti + j * w];
+    const int blocks = (w + BlockSize - 1) / BlockSize;
+    ParallelFor(blocks, threads, [&](const int b0, const int b1) {
+        float val[BlockSize];
+        for (int b = b0; b < b1; b++) {
+            const int x0 = b * BlockSize;
+            const int n = std::min(BlockSize, w - x0);
+            const float *fv = src + x0;
+            const float *lv = src + x0 + w * (h - 1);
+            for (int k = 0; k < n; k++) {
+                val[k] = (r + 1) * fv[k];
+            }
+            for (int j = 0; j < r; j++) {
+                const float *s = src + x0 + j * w;
+                for (int k = 0; k < n; k++) {
+                    val[k] += s[k];
+                }
+            }
+            int ti = x0;
+            int li = ti;
+            int ri = ti + r * w;
+            for (int j = 0; j <= r; j++) {
+                for (int k = 0; k < n; k++) {
+                    val[k] += src[ri + k] - fv[k];
+                    dst[ti + k] = val[k] * m;
+                }
+                ri += w;
+                ti += w;
+            }
+            for (int j = r + 1; j < h - r; j++) {
+                for (int k = 0; k < n; k++) {
+                    val[k] += src[ri + k] - src[li + k];
+                    dst[ti + k] = val[k] * m;
+                }
+                li += w;
+                ri += w;
+                ti += w;
+            }
+            for (int j = h - r; j < h; j++) {
+                for (int k = 0; k < n; k++) {
+                    val[k] += lv[k] - src[li + k];
+                    dst[ti + k] = val[k] * m;
+                }
+                li += w;
+                ti += w;
+            }
         }
-        for (int j = 0; j <= r; j++) {
-            val += src[ri] - fv;
-            dst[ti] = val * m;
-            ri += w;
-            ti += w;
+    });
+}
+
+// blurs data in place, using tmp for the horizontal pass
+void BoxBlur(
+    float *data, float *tmp,
+    const int w, const int h, const int r, const int threads)
+{
+    BoxBlurH(data, tmp, w, h, r, threads);
+    BoxBlurV(tmp, data, w, h, r, threads);
+}
+
+// vertical box pass over rows pushed one at a time in order, the same running
+// sums as BoxBlurV with the rows it still needs kept in a ring
+class StreamBoxV {
+public:
+    StreamBoxV(const int w, const int h, const int r) :
+        m_Width(w),
+        m_Height(h),
+        m_Radius(r),
+        m_Ring(size_t(r * 2 + 2) * w),
+        m_First(w),
+        m_Sum(w),
+        m_Out(w)
+    {}
+
+    // push input row y, then emit(j, row) every output row that became ready
+    template <class Emit>
+    bool Push(const int y, const float *row, const Emit &emit) {
+        const int w = m_Width;
+        const int r = m_Radius;
+        const float m = 1.f / (r + r + 1);
+        std::copy_n(row, w, Row(y));
+        if (y == 0) {
+            std::copy_n(row, w, m_First.data());
+            for (int k = 0; k < w; k++) {
+                m_Sum[k] = (r + 1) * m_First[k];
+            }
+        }
+        if (y < r) {
+            for (int k = 0; k < w; k++) {
+                m_Sum[k] += row[k];
+            }
+            return true;
         }
-        for (int j = r + 1; j < h - r; j++) {
-            val += src[ri] - src[li];
-            dst[ti] = val * m;
-            li += w;
-            ri += w;
-            ti += w;
+
+        // output row j needs input rows j + r and j - r - 1
+        const int j = y - r;
+        const float *sub = j <= r ? m_First.data() : Row(j - r - 1);
+        for (int k = 0; k < w; k++) {
+            m_Sum[k] += row[k] - sub[k];
+            m_Out[k] = m_Sum[k] * m;
+        }
+        if (!emit(j, m_Out.data())) {
+            return false;
         }
-        for (int j = h - r; j < h; j++) {
-            val += lv - src[li];
-            dst[ti] = val * m;
-            li += w;
-            ti += w;
+        if (y < m_Height - 1) {
+            return true;
         }
+
+        // past the last row every column adds its last value
+        const float *last = Row(m_Height - 1);
+        for (int j = m_Height - r; j < m_Height; j++) {
+            const float *sub = Row(j - r - 1);
+            for (int k = 0; k < w; k++) {
+                m_Sum[k] += last[k] - sub[k];
+                m_Out[k] = m_Sum[k] * m;
+            }
+            if (!emit(j, m_Out.data())) {
+                return false;
+            }
+        }
+        return true;
     }
-}
 
+private:
+    float *Row(const int y) {
+        return m_Ring.data() + size_t(y % (m_Radius * 2 + 2)) * m_Width;
+    }
+
+    int m_Width;
+    int m_Height;
+    int m_Radius;
+    std::vector<float> m_Ring;
+    std::vector<float> m_First;
+    std::vector<float> m_Sum;
+    std::vector<float> m_Out;
+};
 
-void BoxBlur(
-    std::vector<float> &src,
-    std::vector<float> &dst,
-    const int w, const int h, const int r)
-{
-    dst.assign(src.begin(), src.end());
-    BoxBlurH(dst, src, w, h, r);
-    BoxBlurV(src, dst, w, h, r);
 }
 
+void GaussianBlur(
+    float *data, float *scratch,
+    const int w, const int h, const int r, const int threads)
+{
+    const std::array<int, 3> boxes = BoxesForGaussian(r);
+    BoxBlur(data, scratch, w, h, (boxes[0] - 1) / 2, threads);
+    BoxBlur(data, scratch, w, h, (boxes[1] - 1) / 2, threads);
+    BoxBlur(data, scratch, w, h, (boxes[2] - 1) / 2, threads);
 }
 
 std::vector<float> GaussianBlur(
     const std::vector<float> &data,
+    const int w, const int h, const int r, const int threads)
+{
+    std::vector<float> result = data;
+    std::vector<float> scratch(data.size());
+    GaussianBlur(result.data(), scratch.data(), w, h, r, threads);
+    return result;
+}
+
+bool GaussianBlurRows(
+    const int w, const int h, const int r,
+    const std::function<bool(int, float *)> &read,
+    const std::function<bool(int, const float *)> &write)
+{
+    const std::array<int, 3> boxes = BoxesForGaussian(r);
+    int radii[3];
+    for (int i = 0; i < 3; i++) {
+        radii[i] = (boxes[i] - 1) / 2;
+        // the in-memory passes read past the raster below this size
+        if (w < radii[i] * 2 + 1 || h < radii[i] * 2 + 1) {
+            return false;
+        }
+    }
+
+    StreamBoxV v0(w, h, radii[0]);
+    StreamBoxV v1(w, h, radii[1]);
+    StreamBoxV v2(w, h, radii[2]);
+    std::vector<float> row(w);
+    std::vector<float> tmp[3] = {
+        std::vector<float>(w), std::vector<float>(w), std::vector<float>(w) };
+
+    // each horizontal pass is row-local, so a row goes through it on its way
+    // into the next vertical pass
+    const auto push2 = [&](const int y, const float *src) {
+        BoxBlurH(src, tmp[2].data(), w, 1, radii[2], 1);
+        return v2.Push(y, tmp[2].data(), write);
+    };
+    const auto push1 = [&](const int y, const float *src) {
+        BoxBlurH(src, tmp[1].data(), w, 1, radii[1], 1);
+        return v1.Push(y, tmp[1].data(), push2);
+    };
+    for (int y = 0; y < h; y++) {
+        if (!read(y, row.data())) {
+            return false;
+        }
+        BoxBlurH(row.data(), tmp[0].data(), w, 1, radii[0], 1);
+        if (!v0.Push(y, tmp[0].data(), push1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GaussianBlurRawFile(
+    const std::string &srcPath, const std::string &dstPath,
     const int w, const int h, const int r)
 {
-    std::vector<float> src = data;
-    std::vector<float> dst(data.size());
-    const std::vector<int> boxes = BoxesForGaussian(r, 3);
-    BoxBlur(src, dst, w, h, (boxes[0] - 1) / 2);
-    BoxBlur(dst, src, w, h, (boxes[1] - 1) / 2);
-    BoxBlur(src, dst, w, h, (boxes[2] - 1) / 2);
-    return dst;
+    HMM_TRACE_SCOPE("GaussianBlurRawFile");
+
+    std::ifstream src(srcPath, std::ios::in | std::ios::binary);
+    std::ofstream dst(dstPath, std::ios::out | std::ios::binary);
+    if (!src || !dst) {
+        return false;
+    }
+    const std::streamsize rowSize = std::streamsize(w) * sizeof(float);
+    const bool ok = GaussianBlurRows(w, h, r,
+        [&](const int, float *row) {
+            return bool(src.read(reinterpret_cast<char *>(row), rowSize));
+        },
+        [&](const int, const float *row) {
+            return bool(dst.write(reinterpret_cast<const char *>(row), rowSize));
+        });
+    dst.close();
+    return ok && !dst.fail();
 }
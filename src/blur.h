@@ -1,7 +1,33 @@
 #pragma once
 
+#include <functional>
+#include <string>
 #include <vector>
 
+// three box blurs approximating a gaussian of sigma r, horizontal passes run
+// over rows and vertical passes over column blocks on threads threads, <= 0 for
+// one per core
 std::vector<float> GaussianBlur(
     const std::vector<float> &data,
+    const int w, const int h, const int r, const int threads);
+
+// same blur in place, with a caller-owned scratch buffer of w * h floats that
+// can be reused between calls. doesn't allocate
+void GaussianBlur(
+    float *data, float *scratch,
+    const int w, const int h, const int r, const int threads);
+
+// the same blur streamed over rows for rasters that don't fit in memory.
+// read(y, row) fills row y with w floats and is called for y = 0..h-1 in order,
+// write(y, row) receives the blurred rows in order. holds 2r + 5 rows per box
+// whatever the height, and the output matches GaussianBlur exactly. false if a
+// callback fails or the raster is narrower than a box
+bool GaussianBlurRows(
+    const int w, const int h, const int r,
+    const std::function<bool(int, float *)> &read,
+    const std::function<bool(int, const float *)> &write);
+
+// GaussianBlurRows from one raw float32 raster file, rows top to bottom, into another
+bool GaussianBlurRawFile(
+    const std::string &srcPath, const std::string &dstPath,
     const int w, const int h, const int r);
@@ -0,0 +1,84 @@
+#include "chunk.h"
+
+#include <algorithm>
+
+#include "trace.h"
+
+namespace {
+
+uint32_t Part1By1(uint32_t x) {
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+}
+
+std::vector<MeshChunk> SplitMeshChunks(
+    const std::vector<glm::vec3> &points,
+    const std::vector<glm::ivec3> &triangles,
+    int maxVertices)
+{
+    HMM_TRACE_SCOPE("SplitMeshChunks");
+
+    maxVertices = std::min(maxVertices, 65535);
+    std::vector<MeshChunk> chunks;
+    if (triangles.empty() || maxVertices < 3) {
+        return chunks;
+    }
+
+    glm::vec3 lo = points[0];
+    glm::vec3 hi = points[0];
+    for (const glm::vec3 &p : points) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    const float sx = hi.x > lo.x ? 65535.f / (hi.x - lo.x) : 0.f;
+    const float sy = hi.y > lo.y ? 65535.f / (hi.y - lo.y) : 0.f;
+
+    // order triangles along a Morton curve through their centroids
+    std::vector<std::pair<uint32_t, int>> keys(triangles.size());
+    for (int i = 0; i < triangles.size(); i++) {
+        const glm::ivec3 &t = triangles[i];
+        const glm::vec3 c = (points[t.x] + points[t.y] + points[t.z]) / 3.f;
+        const uint32_t x = uint32_t((c.x - lo.x) * sx);
+        const uint32_t y = uint32_t((c.y - lo.y) * sy);
+        keys[i] = std::make_pair(Part1By1(x) | (Part1By1(y) << 1), i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // chunk-local index of each point, valid while owner matches the chunk
+    std::vector<int> owner(points.size(), -1);
+    std::vector<uint16_t> local(points.size(), 0);
+    MeshChunk *chunk = nullptr;
+    for (const auto &key : keys) {
+        const glm::ivec3 &t = triangles[key.second];
+        const int c = chunks.size() - 1;
+        int added = 0;
+        for (int j = 0; j < 3; j++) {
+            added += c < 0 || owner[t[j]] != c;
+        }
+        if (!chunk || chunk->Vertices.size() + added > maxVertices) {
+            chunks.emplace_back();
+            chunk = &chunks.back();
+            chunk->Min = points[t.x];
+            chunk->Max = points[t.x];
+        }
+        const int id = chunks.size() - 1;
+        for (int j = 0; j < 3; j++) {
+            const int v = t[j];
+            if (owner[v] != id) {
+                owner[v] = id;
+                local[v] = chunk->Vertices.size();
+                chunk->Vertices.push_back(points[v]);
+                chunk->Min = glm::min(chunk->Min, points[v]);
+                chunk->Max = glm::max(chunk->Max, points[v]);
+            }
+            chunk->Indices.push_back(local[v]);
+        }
+    }
+    return chunks;
+}
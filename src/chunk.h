@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct MeshChunk {
+    std::vector<glm::vec3> Vertices;
+    std::vector<uint16_t> Indices;
+    // bounding box of Vertices
+    glm::vec3 Min;
+    glm::vec3 Max;
+};
+
+// split a mesh into spatially coherent chunks of at most maxVertices (<= 65535)
+// vertices each, so every chunk can use a 16-bit index buffer. triangles are
+// grouped along a Morton curve over their centroids and vertices shared
+// between chunks are duplicated
+std::vector<MeshChunk> SplitMeshChunks(
+    const std::vector<glm::vec3> &points,
+    const std::vector<glm::ivec3> &triangles,
+    int maxVertices);
@@ -0,0 +1,65 @@
+#include "curve.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+uint32_t Bits(const float v) {
+    uint32_t b;
+    memcpy(&b, &v, 4);
+    return b;
+}
+
+// nearest code to v, 0 for NaN
+int Code(const float v) {
+    const float f = v * 65535.f;
+    if (!(f > 0)) {
+        return 0;
+    }
+    return f < 65535.f ? int(f + 0.5f) : 65535;
+}
+
+}
+
+const std::vector<float> &CurveTableInputs() {
+    static const std::vector<float> inputs = [] {
+        // same expression as Heightmap's loader
+        const float m = 1.f / 65535.f;
+        std::vector<float> result(CurveTableSize);
+        for (int i = 0; i < CurveTableSize; i++) {
+            result[i] = i * m;
+        }
+        return result;
+    }();
+    return inputs;
+}
+
+std::vector<float> BuildCurveTable(const std::function<float(float)> &curve) {
+    std::vector<float> table = CurveTableInputs();
+    for (float &v : table) {
+        v = curve(v);
+    }
+    return table;
+}
+
+int ApplyCurveTable(
+    const std::vector<float> &table,
+    const std::function<float(float)> &fallback,
+    float *data, const int n)
+{
+    const float *inputs = CurveTableInputs().data();
+    const float *outputs = table.data();
+    int fallbacks = 0;
+    for (int i = 0; i < n; i++) {
+        const float v = data[i];
+        const int c = Code(v);
+        if (Bits(inputs[c]) == Bits(v)) {
+            data[i] = outputs[c];
+        } else {
+            data[i] = fallback(v);
+            fallbacks++;
+        }
+    }
+    return fallbacks;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+// heightmaps are loaded through stbi_load_16, so before any other op they hold
+// at most 65536 distinct values, code * (1 / 65535.f) for each 16-bit code.
+// a curve over them is a table with one entry per code
+constexpr int CurveTableSize = 65536;
+
+// the value the heightmap loader produces for each code
+const std::vector<float> &CurveTableInputs();
+
+// curve evaluated at every entry of CurveTableInputs
+std::vector<float> BuildCurveTable(const std::function<float(float)> &curve);
+
+// replaces every value that is bit-identical to a table input with its table
+// entry, and every other value with fallback(value), so the result is the same
+// as applying the curve to each value. returns the number of values that fell back
+int ApplyCurveTable(
+    const std::vector<float> &table,
+    const std::function<float(float)> &fallback,
+    float *data, const int n);
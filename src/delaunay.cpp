@@ -0,0 +1,223 @@
+#include "delaunay.h"
+
+namespace
+{
+    int Next(const int e)
+    {
+        return e - e % 3 + (e + 1) % 3;
+    }
+
+    int Prev(const int e)
+    {
+        return e - e % 3 + (e + 2) % 3;
+    }
+
+    // twice the signed area of (a, b, c), negative in the winding every triangle uses
+    int64_t Orient(const glm::ivec2 a, const glm::ivec2 b, const glm::ivec2 c)
+    {
+        return int64_t(b.x - a.x) * (c.y - a.y) - int64_t(b.y - a.y) * (c.x - a.x);
+    }
+}
+
+int DelaunayMesh::AddPoint(const glm::ivec2 point)
+{
+    const int i = m_Points.size();
+    m_Points.push_back(point);
+    m_Edges.push_back(-1);
+    return i;
+}
+
+void DelaunayMesh::InitializeCorners(const int p0, const int p1, const int p2, const int p3)
+{
+    const int t0 = AddTriangle(p3, p0, p2, -1, -1, -1, -1);
+    AddTriangle(p0, p3, p1, t0, -1, -1, -1);
+}
+
+std::vector<glm::ivec3> DelaunayMesh::Triangles() const
+{
+    std::vector<glm::ivec3> triangles;
+    triangles.reserve(NumTriangles());
+    for (int e = 0; e < m_Triangles.size(); e += 3)
+    {
+        if (m_Triangles[e] != m_Triangles[e + 1])
+        {
+            triangles.emplace_back(m_Triangles[e], m_Triangles[e + 1], m_Triangles[e + 2]);
+        }
+    }
+    return triangles;
+}
+
+void DelaunayMesh::ClearChangedTriangles()
+{
+    for (const int t : m_Changed)
+    {
+        m_ChangedFlags[t] = 0;
+    }
+    m_Changed.clear();
+}
+
+int DelaunayMesh::Locate(const glm::ivec2 point, int t) const
+{
+    // visibility walk, always terminates on a Delaunay triangulation
+    for (int e = t * 3, k = 0; k < 3;)
+    {
+        const glm::ivec2 a = m_Points[m_Triangles[e]];
+        const glm::ivec2 b = m_Points[m_Triangles[Next(e)]];
+        if (Orient(a, b, point) > 0 && m_Halfedges[e] >= 0)
+        {
+            e = m_Halfedges[e];
+            t = e / 3;
+            k = 0;
+        }
+        e = Next(e);
+        k++;
+    }
+    return t;
+}
+
+void DelaunayMesh::Remove(const int i)
+{
+    // rotate back to the hull edge leaving i, if i is on the hull
+    const int start = m_Edges[i];
+    int first = start;
+    while (m_Halfedges[first] >= 0)
+    {
+        first = Next(m_Halfedges[first]);
+        if (first == start)
+        {
+            break;
+        }
+    }
+
+    // walk the triangles around i, collecting the polygon of its neighbours and
+    // freeing the triangles. on the hull the polygon is closed by a hull edge
+    m_Ring.clear();
+    m_RingTwins.clear();
+    for (int e = first;;)
+    {
+        m_Ring.push_back(m_Triangles[Next(e)]);
+        m_RingTwins.push_back(m_Halfedges[Next(e)]);
+
+        const int p = Prev(e);
+        const int h = m_Halfedges[p];
+        const int last = m_Triangles[p];
+        const int t = e - e % 3;
+        m_Triangles[t + 0] = m_Triangles[t + 1] = m_Triangles[t + 2] = i;
+        m_Halfedges[t + 0] = m_Halfedges[t + 1] = m_Halfedges[t + 2] = -1;
+        m_Free.push_back(t);
+        MarkChanged(t / 3);
+
+        if (h < 0)
+        {
+            m_Ring.push_back(last);
+            m_RingTwins.push_back(-1);
+            break;
+        }
+        e = h;
+        if (e == first)
+        {
+            break;
+        }
+    }
+    m_Edges[i] = -1;
+
+    // fill the hole by clipping ears whose circumcircle holds no other polygon
+    // vertex, each of which is a triangle of the Delaunay triangulation
+    int n = m_Ring.size();
+    int k = 0;
+    while (n > 3)
+    {
+        const int k1 = (k + 1) % n;
+        const int k2 = (k + 2) % n;
+        const glm::ivec2 a = m_Points[m_Ring[k]];
+        const glm::ivec2 b = m_Points[m_Ring[k1]];
+        const glm::ivec2 c = m_Points[m_Ring[k2]];
+
+        bool ear = Orient(a, b, c) < 0;
+        for (int j = (k + 3) % n; ear && j != k; j = (j + 1) % n)
+        {
+            ear = !InCircle(a, b, c, m_Points[m_Ring[j]]);
+        }
+        if (!ear)
+        {
+            k = k1;
+            continue;
+        }
+
+        const int e = AddTriangle(
+            m_Ring[k], m_Ring[k1], m_Ring[k2],
+            m_RingTwins[k], m_RingTwins[k1], -1, -1);
+        m_RingTwins[k] = e + 2;
+        m_Ring.erase(m_Ring.begin() + k1);
+        m_RingTwins.erase(m_RingTwins.begin() + k1);
+        n--;
+        k = k1 < k ? k - 1 : k;
+    }
+    AddTriangle(
+        m_Ring[0], m_Ring[1], m_Ring[2],
+        m_RingTwins[0], m_RingTwins[1], m_RingTwins[2], -1);
+}
+
+int DelaunayMesh::AddTriangle(
+    const int a, const int b, const int c,
+    const int ab, const int bc, const int ca,
+    int e)
+{
+    if (e < 0 && !m_Free.empty())
+    {
+        e = m_Free.back();
+        m_Free.pop_back();
+    }
+
+    if (e < 0)
+    {
+        e = m_Triangles.size();
+        m_Triangles.push_back(a);
+        m_Triangles.push_back(b);
+        m_Triangles.push_back(c);
+        m_Halfedges.push_back(ab);
+        m_Halfedges.push_back(bc);
+        m_Halfedges.push_back(ca);
+    }
+    else
+    {
+        m_Triangles[e + 0] = a;
+        m_Triangles[e + 1] = b;
+        m_Triangles[e + 2] = c;
+        m_Halfedges[e + 0] = ab;
+        m_Halfedges[e + 1] = bc;
+        m_Halfedges[e + 2] = ca;
+    }
+
+    if (ab >= 0)
+    {
+        m_Halfedges[ab] = e + 0;
+    }
+    if (bc >= 0)
+    {
+        m_Halfedges[bc] = e + 1;
+    }
+    if (ca >= 0)
+    {
+        m_Halfedges[ca] = e + 2;
+    }
+
+    m_Edges[a] = e + 0;
+    m_Edges[b] = e + 1;
+    m_Edges[c] = e + 2;
+    MarkChanged(e / 3);
+    return e;
+}
+
+void DelaunayMesh::MarkChanged(const int t)
+{
+    if (t >= m_ChangedFlags.size())
+    {
+        m_ChangedFlags.resize(t + 1, 0);
+    }
+    if (!m_ChangedFlags[t])
+    {
+        m_ChangedFlags[t] = 1;
+        m_Changed.push_back(t);
+    }
+}
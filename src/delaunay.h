@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "insertion.h"
+
+// halfedge Delaunay triangulation of integer points inside a rectangle, using the
+// same insertion rules (collinear splits, flips) and slot layout as Triangulator,
+// plus point removal. triangle slots freed by removals are reused by later insertions
+class DelaunayMesh : private DelaunayInsertion<DelaunayMesh>
+{
+public:
+    // add a point without inserting it into the triangulation, returns its index
+    int AddPoint(const glm::ivec2 point);
+
+    // two triangles over the rectangle's corners (x0, y0), (x1, y0), (x0, y1), (x1, y1),
+    // the same ones Triangulator::Initialize starts from
+    void InitializeCorners(const int p0, const int p1, const int p2, const int p3);
+
+    // insert point pn, which lies inside or on an edge of triangle slot t, like Triangulator::Step
+    using DelaunayInsertion::Insert;
+
+    // triangle slot containing point, walking from triangle slot t
+    int Locate(const glm::ivec2 point, int t) const;
+
+    // a triangle slot around point i, only valid while i is part of the triangulation
+    int PointTriangle(const int i) const
+    {
+        return m_Edges[i] / 3;
+    }
+
+    // remove point i, which must not be one of the corners, and fill its hole
+    // with the Delaunay triangles of its neighbours
+    void Remove(const int i);
+
+    const std::vector<glm::ivec2>& Points() const
+    {
+        return m_Points;
+    }
+
+    // point indices of every triangle slot, free slots are degenerate (all three equal)
+    const std::vector<int>& TriangleIndices() const
+    {
+        return m_Triangles;
+    }
+
+    const std::vector<int>& Halfedges() const
+    {
+        return m_Halfedges;
+    }
+
+    int NumTriangles() const
+    {
+        return m_Triangles.size() / 3 - m_Free.size();
+    }
+
+    // the triangles of every slot in use, in slot order
+    std::vector<glm::ivec3> Triangles() const;
+
+    // slots written or freed since the last clear, each listed once
+    const std::vector<int>& ChangedTriangles() const
+    {
+        return m_Changed;
+    }
+
+    void ClearChangedTriangles();
+
+private:
+    friend class DelaunayInsertion<DelaunayMesh>;
+
+    int AddTriangle(
+        const int a, const int b, const int c,
+        const int ab, const int bc, const int ca,
+        int e);
+
+    void BeforeCollinearSplit(const int)
+    {
+    }
+
+    void BeforeFlip(const int, const int)
+    {
+    }
+
+    void MarkChanged(const int t);
+
+    std::vector<glm::ivec2> m_Points;
+    // a halfedge starting at each point
+    std::vector<int> m_Edges;
+    std::vector<int> m_Triangles;
+    std::vector<int> m_Halfedges;
+    std::vector<int> m_Free;
+
+    std::vector<int> m_Changed;
+    std::vector<uint8_t> m_ChangedFlags;
+
+    // the hole left by Remove, as a polygon with the outside halfedge of each edge
+    std::vector<int> m_Ring;
+    std::vector<int> m_RingTwins;
+};
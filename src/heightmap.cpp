@@ -1,10 +1,23 @@
 #include "heightmap.h"
 
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/normal.hpp>
 #include <glm/gtx/polar_coordinates.hpp>
 
 #include "blur.h"
+#include "curve.h"
+#include "mapped.h"
+#include "minmax.h"
+#include "parallel.h"
+#include "trace.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -12,10 +25,175 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
-Heightmap::Heightmap(const std::string &path) :
-    m_Width(0),
-    m_Height(0)
+namespace {
+
+// small enough for a chunk to stay in L2 while a pointwise op runs over it
+constexpr int ChunkSize = 1 << 14;
+
+// normals of the n cells between rows r0 and r1, heights scaled by s. each cell
+// is split into four triangles around its center, whose normals reduce to
+// (a, b, 1) / |(a, b, 1)| in terms of the corner heights relative to the
+// center. the normalized sum is the same as adding up glm::triangleNormal for
+// the four triangles. sqrt and division are exact in SSE too, so the vector
+// path gives the same normals as the scalar one
+void NormalRow(
+    const float *r0, const float *r1, const int n, const float s,
+    float *nx, float *ny, float *nz)
 {
+    int x = 0;
+#if defined(__SSE__) || defined(_M_X64)
+    const __m128 vs = _mm_set1_ps(s);
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 four = _mm_set1_ps(4.f);
+    const __m128 sign = _mm_set1_ps(-0.f);
+    const auto inverseLength = [one](const __m128 a, const __m128 b) {
+        const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), one);
+        return _mm_div_ps(one, _mm_sqrt_ps(d));
+    };
+    for (; x + 4 <= n; x += 4) {
+        const __m128 z00 = _mm_mul_ps(_mm_loadu_ps(r0 + x), vs);
+        const __m128 z10 = _mm_mul_ps(_mm_loadu_ps(r0 + x + 1), vs);
+        const __m128 z01 = _mm_mul_ps(_mm_loadu_ps(r1 + x), vs);
+        const __m128 z11 = _mm_mul_ps(_mm_loadu_ps(r1 + x + 1), vs);
+        const __m128 zc = _mm_div_ps(
+            _mm_add_ps(_mm_add_ps(_mm_add_ps(z00, z01), z10), z11), four);
+        const __m128 d00 = _mm_sub_ps(z00, zc);
+        const __m128 d10 = _mm_sub_ps(z10, zc);
+        const __m128 d01 = _mm_sub_ps(z01, zc);
+        const __m128 d11 = _mm_sub_ps(z11, zc);
+
+        const __m128 a0 = _mm_sub_ps(d00, d10);
+        const __m128 b0 = _mm_add_ps(d00, d10);
+        const __m128 a1 = _mm_xor_ps(sign, _mm_add_ps(d10, d11));
+        const __m128 b1 = _mm_sub_ps(d10, d11);
+        const __m128 a2 = _mm_sub_ps(d01, d11);
+        const __m128 b2 = _mm_xor_ps(sign, _mm_add_ps(d11, d01));
+        const __m128 a3 = _mm_add_ps(d00, d01);
+        const __m128 b3 = _mm_sub_ps(d00, d01);
+        const __m128 l0 = inverseLength(a0, b0);
+        const __m128 l1 = inverseLength(a1, b1);
+        const __m128 l2 = inverseLength(a2, b2);
+        const __m128 l3 = inverseLength(a3, b3);
+
+        const __m128 sx = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(a0, l0), _mm_mul_ps(a1, l1)), _mm_mul_ps(a2, l2)), _mm_mul_ps(a3, l3));
+        const __m128 sy = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(b0, l0), _mm_mul_ps(b1, l1)), _mm_mul_ps(b2, l2)), _mm_mul_ps(b3, l3));
+        const __m128 sz = _mm_add_ps(_mm_add_ps(_mm_add_ps(l0, l1), l2), l3);
+        const __m128 l = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy)), _mm_mul_ps(sz, sz))));
+        _mm_storeu_ps(nx + x, _mm_mul_ps(sx, l));
+        _mm_storeu_ps(ny + x, _mm_mul_ps(sy, l));
+        _mm_storeu_ps(nz + x, _mm_mul_ps(sz, l));
+    }
+#endif
+    for (; x < n; x++) {
+        const float z00 = r0[x] * s;
+        const float z10 = r0[x + 1] * s;
+        const float z01 = r1[x] * s;
+        const float z11 = r1[x + 1] * s;
+        const float zc = (z00 + z01 + z10 + z11) / 4.f;
+        const float d00 = z00 - zc;
+        const float d10 = z10 - zc;
+        const float d01 = z01 - zc;
+        const float d11 = z11 - zc;
+
+        // (pc, p00, p10), (pc, p10, p11), (pc, p11, p01), (pc, p01, p00)
+        const float a0 = d00 - d10;
+        const float b0 = d00 + d10;
+        const float a1 = -(d10 + d11);
+        const float b1 = d10 - d11;
+        const float a2 = d01 - d11;
+        const float b2 = -(d11 + d01);
+        const float a3 = d00 + d01;
+        const float b3 = d00 - d01;
+        const float l0 = 1.f / std::sqrt(a0 * a0 + b0 * b0 + 1.f);
+        const float l1 = 1.f / std::sqrt(a1 * a1 + b1 * b1 + 1.f);
+        const float l2 = 1.f / std::sqrt(a2 * a2 + b2 * b2 + 1.f);
+        const float l3 = 1.f / std::sqrt(a3 * a3 + b3 * b3 + 1.f);
+
+        const float sx = a0 * l0 + a1 * l1 + a2 * l2 + a3 * l3;
+        const float sy = b0 * l0 + b1 * l1 + b2 * l2 + b3 * l3;
+        const float sz = l0 + l1 + l2 + l3;
+        const float l = 1.f / std::sqrt(sx * sx + sy * sy + sz * sz);
+        nx[x] = sx * l;
+        ny[x] = sy * l;
+        nz[x] = sz * l;
+    }
+}
+
+// reads the ESRI-style header next to a raw grid, one key and value per line:
+// ncols and nrows are required, nbits, byteorder and skipbytes are checked or
+// used when present and anything else is ignored
+bool ReadRawHeader(
+    const std::string &path, const int bits,
+    int &width, int &height, size_t &skip)
+{
+    std::ifstream file(path.substr(0, path.find_last_of('.')) + ".hdr");
+    if (!file) {
+        return false;
+    }
+    width = 0;
+    height = 0;
+    skip = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string key, value;
+        if (!(fields >> key >> value)) {
+            continue;
+        }
+        for (char &c : key) {
+            c = std::tolower(c);
+        }
+        for (char &c : value) {
+            c = std::toupper(c);
+        }
+        if (key == "ncols") {
+            width = std::atoi(value.c_str());
+        } else if (key == "nrows") {
+            height = std::atoi(value.c_str());
+        } else if (key == "nbits") {
+            if (std::atoi(value.c_str()) != bits) {
+                return false;
+            }
+        } else if (key == "byteorder") {
+            // the values are used as they are, which is only right on a
+            // little-endian host like every target this builds for
+            if (value != "I" && value != "LSBFIRST") {
+                return false;
+            }
+        } else if (key == "skipbytes") {
+            skip = std::strtoull(value.c_str(), nullptr, 10);
+        }
+    }
+    return width > 0 && height > 0 && size_t(width) * height <= INT_MAX;
+}
+
+// calls fn(data, count) on consecutive chunks of [0, n), spread over threads
+template <class Fn>
+void ForEachChunk(float *data, const size_t n, const int threads, const Fn &fn) {
+    const int chunks = (n + ChunkSize - 1) / ChunkSize;
+    ParallelFor(chunks, threads, [&](const int c0, const int c1) {
+        for (int c = c0; c < c1; c++) {
+            const size_t i = size_t(c) * ChunkSize;
+            fn(data + i, int(std::min<size_t>(ChunkSize, n - i)));
+        }
+    });
+}
+
+}
+
+Heightmap::Heightmap(const std::string &path) {
+    HMM_TRACE_SCOPE("Heightmap::Load");
+    std::string ext = path.substr(std::min(path.find_last_of('.'), path.size()));
+    for (char &c : ext) {
+        c = std::tolower(c);
+    }
+    if (ext == ".r16" || ext == ".f32") {
+        LoadRaw(path, ext == ".r16" ? 16 : 32);
+        return;
+    }
     int w, h, c;
     uint16_t *data = stbi_load_16(path.c_str(), &w, &h, &c, 1);
     if (!data) {
@@ -30,6 +208,52 @@ Heightmap::Heightmap(const std::string &path) :
         m_Data[i] = data[i] * m;
     }
     free(data);
+    m_Values = m_Data.data();
+    m_Quantized = true;
+}
+
+void Heightmap::LoadRaw(const std::string &path, const int bits) {
+    int w, h;
+    size_t skip;
+    if (!ReadRawHeader(path, bits, w, h, skip)) {
+        return;
+    }
+    std::shared_ptr<const MappedFile> file = std::make_shared<const MappedFile>(path);
+    const size_t n = size_t(w) * h;
+    const size_t bytes = bits / 8;
+    if (!file->Data() || file->Size() < skip || (file->Size() - skip) / bytes < n) {
+        return;
+    }
+    const uint8_t *data = file->Data() + skip;
+
+    if (bits == 32 && skip % alignof(float) == 0) {
+        // the heights are the file's bytes, pages are read as they're touched
+        m_Mapping = std::move(file);
+        m_Values = reinterpret_cast<const float *>(data);
+    } else if (bits == 32) {
+        m_Data.resize(n);
+        std::memcpy(m_Data.data(), data, n * sizeof(float));
+        m_Values = m_Data.data();
+    } else {
+        // scaled like the stb_image codes, straight from the mapped file
+        const float m = 1.f / 65535.f;
+        m_Data.resize(n);
+        float *values = m_Data.data();
+        const int chunks = (n + ChunkSize - 1) / ChunkSize;
+        ParallelFor(chunks, m_Threads, [&](const int c0, const int c1) {
+            const size_t i0 = size_t(c0) * ChunkSize;
+            const size_t i1 = std::min(n, size_t(c1) * ChunkSize);
+            for (size_t i = i0; i < i1; i++) {
+                uint16_t v;
+                std::memcpy(&v, data + i * 2, 2);
+                values[i] = v * m;
+            }
+        });
+        m_Values = m_Data.data();
+        m_Quantized = true;
+    }
+    m_Width = w;
+    m_Height = h;
 }
 
 Heightmap::Heightmap(
@@ -38,101 +262,287 @@ Heightmap::Heightmap(
     const std::vector<float> &data) :
     m_Width(width),
     m_Height(height),
-    m_Data(data)
+    m_Data(data),
+    m_Values(m_Data.data())
 {}
 
 void Heightmap::AutoLevel() {
-    float lo = m_Data[0];
-    float hi = m_Data[0];
-    for (int i = 0; i < m_Data.size(); i++) {
-        lo = std::min(lo, m_Data[i]);
-        hi = std::max(hi, m_Data[i]);
+    HMM_TRACE_SCOPE("Heightmap::AutoLevel");
+    const float *data = m_Values;
+    const size_t n = Count();
+
+    // every chunk starts from the first value like the scalar loop, so a NaN
+    // there still wins and NaNs anywhere else are still skipped. with a border
+    // the first value is a border pixel
+    const float first = m_Border > 0 ? m_BorderZ : data[0];
+    const int chunks = (n + ChunkSize - 1) / ChunkSize;
+    std::vector<float> los(chunks, first);
+    std::vector<float> his(chunks, first);
+    ParallelFor(chunks, m_Threads, [&](const int c0, const int c1) {
+        for (int c = c0; c < c1; c++) {
+            const size_t i = size_t(c) * ChunkSize;
+            MinMax(data + i, int(std::min<size_t>(ChunkSize, n - i)), los[c], his[c]);
+        }
+    });
+    float lo = first;
+    float hi = first;
+    for (int c = 0; c < chunks; c++) {
+        lo = std::min(lo, los[c]);
+        hi = std::max(hi, his[c]);
     }
+
+    // the scalar loop keeps the first of -0 and +0, which only matters for
+    // which sign the leveled zeros get
+    const auto firstZero = [&]() {
+        return first == 0 ? first : *std::find(data, data + n, 0.f);
+    };
+    if (lo == 0) {
+        lo = firstZero();
+    }
+    if (hi == 0) {
+        hi = firstZero();
+    }
+
     if (hi == lo) {
         return;
     }
-    for (int i = 0; i < m_Data.size(); i++) {
-        m_Data[i] = (m_Data[i] - lo) / (hi - lo);
-    }
+    ForEachChunk(Writable(), n, m_Threads, [lo, hi](float *d, const int count) {
+        for (int i = 0; i < count; i++) {
+            d[i] = (d[i] - lo) / (hi - lo);
+        }
+    });
+    m_BorderZ = (m_BorderZ - lo) / (hi - lo);
+    m_Quantized = false;
+    Invalidate();
 }
 
 void Heightmap::Invert() {
-    for (int i = 0; i < m_Data.size(); i++) {
-        m_Data[i] = 1.f - m_Data[i];
-    }
+    HMM_TRACE_SCOPE("Heightmap::Invert");
+    ForEachChunk(Writable(), Count(), m_Threads, [](float *d, const int count) {
+        for (int i = 0; i < count; i++) {
+            d[i] = 1.f - d[i];
+        }
+    });
+    m_BorderZ = 1.f - m_BorderZ;
+    m_Quantized = false;
+    Invalidate();
 }
 
 void Heightmap::GammaCurve(const float gamma) {
-    for (int i = 0; i < m_Data.size(); i++) {
-        m_Data[i] = std::pow(m_Data[i], gamma);
+    HMM_TRACE_SCOPE("Heightmap::GammaCurve");
+    if (m_Quantized && Count() > CurveTableSize) {
+        ToneCurve([gamma](const float v) {
+            return std::pow(v, gamma);
+        });
+        return;
+    }
+    ForEachChunk(Writable(), Count(), m_Threads, [gamma](float *d, const int count) {
+        for (int i = 0; i < count; i++) {
+            d[i] = std::pow(d[i], gamma);
+        }
+    });
+    m_BorderZ = std::pow(m_BorderZ, gamma);
+    m_Quantized = false;
+    Invalidate();
+}
+
+void Heightmap::ToneCurve(const std::function<float(float)> &curve) {
+    HMM_TRACE_SCOPE("Heightmap::ToneCurve");
+    if (m_Quantized) {
+        const std::vector<float> table = BuildCurveTable(curve);
+        ForEachChunk(Writable(), Count(), m_Threads, [&](float *d, const int count) {
+            ApplyCurveTable(table, curve, d, count);
+        });
+    } else {
+        ForEachChunk(Writable(), Count(), m_Threads, [&](float *d, const int count) {
+            for (int i = 0; i < count; i++) {
+                d[i] = curve(d[i]);
+            }
+        });
     }
+    m_BorderZ = curve(m_BorderZ);
+    m_Quantized = false;
+    Invalidate();
 }
 
 void Heightmap::AddBorder(const int size, const float z) {
-    const int w = m_Width + size * 2;
-    const int h = m_Height + size * 2;
-    std::vector<float> data(w * h, z);
-    int i = 0;
-    for (int y = 0; y < m_Height; y++) {
-        int j = (y + size) * w + size;
-        for (int x = 0; x < m_Width; x++) {
-            data[j++] = m_Data[i++];
-        }
+    HMM_TRACE_SCOPE("Heightmap::AddBorder");
+    if (size <= 0) {
+        return;
     }
-    m_Width = w;
-    m_Height = h;
-    m_Data = data;
+    // a border of a different height around the current one has to be stored
+    if (m_Border > 0 && std::memcmp(&z, &m_BorderZ, sizeof(float)) != 0) {
+        Materialize();
+    }
+    m_Width += size * 2;
+    m_Height += size * 2;
+    m_Border += size;
+    m_BorderZ = z;
+    Invalidate();
 }
 
 void Heightmap::GaussianBlur(const int r) {
-    m_Data = ::GaussianBlur(m_Data, m_Width, m_Height, r);
+    std::vector<float> scratch;
+    GaussianBlur(r, scratch);
 }
 
-std::vector<glm::vec3> Heightmap::Normalmap(const float zScale) const {
+void Heightmap::GaussianBlur(const int r, std::vector<float> &scratch) {
+    HMM_TRACE_SCOPE("Heightmap::GaussianBlur");
+    Materialize();
+    if (scratch.size() < Count()) {
+        scratch.resize(Count());
+    }
+    ::GaussianBlur(Writable(), scratch.data(), m_Width, m_Height, r, m_Threads);
+    m_Quantized = false;
+    Invalidate();
+}
+
+float *Heightmap::Writable() {
+    if (m_Mapping) {
+        m_Data.assign(m_Values, m_Values + Count());
+        m_Values = m_Data.data();
+        m_Mapping.reset();
+    }
+    return m_Data.data();
+}
+
+void Heightmap::Materialize() {
+    if (m_Border == 0) {
+        return;
+    }
+    HMM_TRACE_SCOPE("Heightmap::Materialize");
+    const int size = m_Border;
+    const int w = m_Width - size * 2;
+    const int h = m_Height - size * 2;
+    std::vector<float> data(size_t(m_Width) * m_Height, m_BorderZ);
+    for (int y = 0; y < h; y++) {
+        std::copy_n(
+            m_Values + size_t(y) * w, w,
+            data.data() + size_t(y + size) * m_Width + size);
+    }
+    m_Data = std::move(data);
+    m_Values = m_Data.data();
+    m_Mapping.reset();
+    m_Border = 0;
+    m_Quantized = false;
+}
+
+void Heightmap::Invalidate() {
+    std::lock_guard<std::mutex> lock(m_CacheMutex);
+    m_Normals.reset();
+}
+
+bool Heightmap::Quantized() const {
+    const bool borderCode = std::round(m_BorderZ * 65535.f) * (1.f / 65535.f) == m_BorderZ;
+    return m_Quantized && (m_Border == 0 || borderCode);
+}
+
+void Heightmap::Row(const int y, float *row) const {
+    const int iw = m_Width - m_Border * 2;
+    const int iy = y - m_Border;
+    if (unsigned(iy) >= unsigned(m_Height - m_Border * 2)) {
+        std::fill_n(row, m_Width, m_BorderZ);
+        return;
+    }
+    std::fill_n(row, m_Border, m_BorderZ);
+    std::copy_n(m_Values + size_t(iy) * iw, iw, row + m_Border);
+    std::fill_n(row + m_Border + iw, m_Border, m_BorderZ);
+}
+
+template <class Fn>
+void Heightmap::ForEachNormalRow(const float zScale, const Fn &fn) const {
     const int w = m_Width - 1;
     const int h = m_Height - 1;
-    std::vector<glm::vec3> result(w * h);
-    int i = 0;
-    for (int y0 = 0; y0 < h; y0++) {
-        const int y1 = y0 + 1;
-        const float yc = y0 + 0.5f;
-        for (int x0 = 0; x0 < w; x0++) {
-            const int x1 = x0 + 1;
-            const float xc = x0 + 0.5f;
-            const float z00 = At(x0, y0) * -zScale;
-            const float z01 = At(x0, y1) * -zScale;
-            const float z10 = At(x1, y0) * -zScale;
-            const float z11 = At(x1, y1) * -zScale;
-            const float zc = (z00 + z01 + z10 + z11) / 4.f;
-            const glm::vec3 p00(x0, y0, z00);
-            const glm::vec3 p01(x0, y1, z01);
-            const glm::vec3 p10(x1, y0, z10);
-            const glm::vec3 p11(x1, y1, z11);
-            const glm::vec3 pc(xc, yc, zc);
-            const glm::vec3 n0 = glm::triangleNormal(pc, p00, p10);
-            const glm::vec3 n1 = glm::triangleNormal(pc, p10, p11);
-            const glm::vec3 n2 = glm::triangleNormal(pc, p11, p01);
-            const glm::vec3 n3 = glm::triangleNormal(pc, p01, p00);
-            result[i] = glm::normalize(n0 + n1 + n2 + n3);
-            i++;
+    ParallelFor(h, m_Threads, [&](const int y0, const int y1) {
+        std::vector<float> rows(m_Width * 2);
+        std::vector<float> normals(w * 3);
+        float *r0 = rows.data();
+        float *r1 = r0 + m_Width;
+        float *nx = normals.data();
+        float *ny = nx + w;
+        float *nz = ny + w;
+        Row(y0, r1);
+        for (int y = y0; y < y1; y++) {
+            std::swap(r0, r1);
+            Row(y + 1, r1);
+            NormalRow(r0, r1, w, -zScale, nx, ny, nz);
+            fn(y, nx, ny, nz);
         }
-    }
+    });
+}
+
+std::vector<glm::vec3> Heightmap::Normalmap(const float zScale) const {
+    HMM_TRACE_SCOPE("Heightmap::Normalmap");
+    const int w = m_Width - 1;
+    std::vector<glm::vec3> result(size_t(w) * (m_Height - 1));
+    ForEachNormalRow(zScale, [&](const int y, const float *nx, const float *ny, const float *nz) {
+        glm::vec3 *dst = result.data() + size_t(y) * w;
+        for (int x = 0; x < w; x++) {
+            dst[x] = glm::vec3(nx[x], ny[x], nz[x]);
+        }
+    });
+    return result;
+}
+
+std::vector<uint8_t> Heightmap::NormalmapRGB8(const float zScale) const {
+    HMM_TRACE_SCOPE("Heightmap::NormalmapRGB8");
+    const int w = m_Width - 1;
+    std::vector<uint8_t> result(size_t(w) * (m_Height - 1) * 3);
+    ForEachNormalRow(zScale, [&](const int y, const float *nx, const float *ny, const float *nz) {
+        uint8_t *dst = result.data() + size_t(y) * w * 3;
+        for (int x = 0; x < w; x++) {
+            dst[x * 3 + 0] = uint8_t((nx[x] + 1.f) / 2.f * 255);
+            dst[x * 3 + 1] = uint8_t((ny[x] + 1.f) / 2.f * 255);
+            dst[x * 3 + 2] = uint8_t((nz[x] + 1.f) / 2.f * 255);
+        }
+    });
     return result;
 }
 
+std::vector<uint16_t> Heightmap::NormalmapOctahedral(const float zScale) const {
+    HMM_TRACE_SCOPE("Heightmap::NormalmapOctahedral");
+    const int w = m_Width - 1;
+    std::vector<uint16_t> result(size_t(w) * (m_Height - 1) * 2);
+    ForEachNormalRow(zScale, [&](const int y, const float *nx, const float *ny, const float *nz) {
+        uint16_t *dst = result.data() + size_t(y) * w * 2;
+        for (int x = 0; x < w; x++) {
+            // project onto the octahedron, folding the lower half over the upper
+            const float l = std::abs(nx[x]) + std::abs(ny[x]) + std::abs(nz[x]);
+            float u = nx[x] / l;
+            float v = ny[x] / l;
+            if (nz[x] < 0) {
+                const float fu = (1.f - std::abs(v)) * (u >= 0 ? 1.f : -1.f);
+                const float fv = (1.f - std::abs(u)) * (v >= 0 ? 1.f : -1.f);
+                u = fu;
+                v = fv;
+            }
+            dst[x * 2 + 0] = uint16_t(std::round((u * 0.5f + 0.5f) * 65535));
+            dst[x * 2 + 1] = uint16_t(std::round((v * 0.5f + 0.5f) * 65535));
+        }
+    });
+    return result;
+}
+
+std::shared_ptr<const std::vector<uint16_t>> Heightmap::CachedNormalmap(const float zScale) const {
+    std::lock_guard<std::mutex> lock(m_CacheMutex);
+    if (!m_Normals || m_NormalsZScale != zScale) {
+        m_Normals = std::make_shared<const std::vector<uint16_t>>(NormalmapOctahedral(zScale));
+        m_NormalsZScale = zScale;
+    }
+    return m_Normals;
+}
+
+void Heightmap::ReleaseNormalmap() const {
+    std::lock_guard<std::mutex> lock(m_CacheMutex);
+    m_Normals.reset();
+}
+
 void Heightmap::SaveNormalmap(
     const std::string &path,
     const float zScale) const
 {
-    const std::vector<glm::vec3> nm = Normalmap(zScale);
-    std::vector<uint8_t> data(nm.size() * 3);
-    int i = 0;
-    for (glm::vec3 n : nm) {
-        n = (n + 1.f) / 2.f;
-        data[i++] = uint8_t(n.x * 255);
-        data[i++] = uint8_t(n.y * 255);
-        data[i++] = uint8_t(n.z * 255);
-    }
+    HMM_TRACE_SCOPE("Heightmap::SaveNormalmap");
+    const std::vector<uint8_t> data = NormalmapRGB8(zScale);
     stbi_write_png(
         path.c_str(), m_Width - 1, m_Height - 1, 3,
         data.data(), (m_Width - 1) * 3);
@@ -144,17 +554,32 @@ void Heightmap::SaveHillshade(
     const float altitude,
     const float azimuth) const
 {
+    HMM_TRACE_SCOPE("Heightmap::SaveHillshade");
     const glm::vec3 light = glm::euclidean(glm::vec2(
         glm::radians(altitude), glm::radians(-azimuth))).xzy();
-    const std::vector<glm::vec3> nm = Normalmap(zScale);
-    std::vector<uint8_t> data(nm.size() * 3);
-    int i = 0;
-    for (glm::vec3 n : nm) {
-        const uint8_t d = glm::clamp(glm::dot(n, light), 0.f, 1.f) * 255;
-        data[i++] = d;
-        data[i++] = d;
-        data[i++] = d;
-    }
+    const std::shared_ptr<const std::vector<uint16_t>> nm = CachedNormalmap(zScale);
+    const int w = m_Width - 1;
+    std::vector<uint8_t> data(size_t(w) * (m_Height - 1) * 3);
+    ParallelFor(m_Height - 1, m_Threads, [&](const int y0, const int y1) {
+        for (int y = y0; y < y1; y++) {
+            const uint16_t *src = nm->data() + size_t(y) * w * 2;
+            uint8_t *dst = data.data() + size_t(y) * w * 3;
+            for (int x = 0; x < w; x++) {
+                // unfold the octahedron, see NormalmapOctahedral
+                const float u = src[x * 2 + 0] / 65535.f * 2 - 1;
+                const float v = src[x * 2 + 1] / 65535.f * 2 - 1;
+                glm::vec3 n(u, v, 1.f - std::abs(u) - std::abs(v));
+                if (n.z < 0) {
+                    n.x = (1.f - std::abs(v)) * (u >= 0 ? 1.f : -1.f);
+                    n.y = (1.f - std::abs(u)) * (v >= 0 ? 1.f : -1.f);
+                }
+                const uint8_t d = glm::clamp(glm::dot(glm::normalize(n), light), 0.f, 1.f) * 255;
+                dst[x * 3 + 0] = d;
+                dst[x * 3 + 1] = d;
+                dst[x * 3 + 2] = d;
+            }
+        }
+    });
     stbi_write_png(
         path.c_str(), m_Width - 1, m_Height - 1, 3,
         data.data(), (m_Width - 1) * 3);
@@ -163,7 +588,8 @@ void Heightmap::SaveHillshade(
 std::pair<glm::ivec2, float> Heightmap::FindCandidate(
     const glm::ivec2 p0,
     const glm::ivec2 p1,
-    const glm::ivec2 p2) const
+    const glm::ivec2 p2,
+    [[maybe_unused]] uint64_t *pixelsRasterized) const
 {
     const auto edge = [](
         const glm::ivec2 a, const glm::ivec2 b, const glm::ivec2 c)
@@ -192,9 +618,15 @@ std::pair<glm::ivec2, float> Heightmap::FindCandidate(
     const float z1 = At(p1) / a;
     const float z2 = At(p2) / a;
 
+    // pixels inside the border, outside of it every pixel is m_BorderZ
+    const int iw = m_Width - m_Border * 2;
+    const int ih = m_Height - m_Border * 2;
+    const float *data = m_Values;
+
     // iterate over pixels in bounding box
     float maxError = 0;
     glm::ivec2 maxPoint(0);
+    [[maybe_unused]] uint64_t pixels = 0;
     for (int y = min.y; y <= max.y; y++) {
         // compute starting offset
         int dx = 0;
@@ -214,32 +646,60 @@ std::pair<glm::ivec2, float> Heightmap::FindCandidate(
 
         bool wasInside = false;
 
-        for (int x = min.x + dx; x <= max.x; x++) {
-            // check if inside triangle
-            if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
-                wasInside = true;
-
-                // compute z using barycentric coordinates
-                const float z = z0 * w0 + z1 * w1 + z2 * w2;
-                const float dz = std::abs(z - At(x, y));
-                if (dz > maxError) {
-                    maxError = dz;
-                    maxPoint = glm::ivec2(x, y);
+        // visits [x, end) with value(x) as the height, false once past the triangle
+        int x = min.x + dx;
+        const auto span = [&](const int end, const auto &value) {
+            for (; x < end; x++) {
+                // check if inside triangle
+                if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
+                    wasInside = true;
+                    HMM_STAT(pixels++);
+
+                    // compute z using barycentric coordinates
+                    const float z = z0 * w0 + z1 * w1 + z2 * w2;
+                    const float dz = std::abs(z - value(x));
+                    if (dz > maxError) {
+                        maxError = dz;
+                        maxPoint = glm::ivec2(x, y);
+                    }
+                } else if (wasInside) {
+                    return false;
                 }
-            } else if (wasInside) {
-                break;
+
+                w0 += a12;
+                w1 += a20;
+                w2 += a01;
             }
+            return true;
+        };
 
-            w0 += a12;
-            w1 += a20;
-            w2 += a01;
+        // split the row into the border left of the data, the data and the
+        // border right of it, so the data span is a plain load per pixel.
+        // border rows are all left border
+        const int end = max.x + 1;
+        int xa = end;
+        int xb = end;
+        const float *row = data;
+        if (unsigned(y - m_Border) < unsigned(ih)) {
+            xa = std::min(std::max(m_Border, x), end);
+            xb = std::min(std::max(m_Border + iw, xa), end);
+            row = data + (y - m_Border) * iw - m_Border;
         }
+        const auto border = [this](int) { return m_BorderZ; };
+        const auto inner = [row](const int i) { return row[i]; };
+        span(xa, border) && span(xb, inner) && span(end, border);
 
         w00 += b12;
         w01 += b20;
         w02 += b01;
     }
 
+#if HMM_ENABLE_STATS
+    if (pixelsRasterized) {
+        *pixelsRasterized += pixels;
+    }
+#endif
+
     if (maxPoint == p0 || maxPoint == p1 || maxPoint == p2) {
         maxError = 0;
     }
@@ -1,13 +1,26 @@
 #pragma once
 
 #define GLM_FORCE_SWIZZLE
+#include <algorithm>
+#include <functional>
 #include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "stats.h"
+
+class MappedFile;
+
 class Heightmap {
 public:
+    // .r16 and .f32 files are raw little-endian grids described by a sidecar
+    // header with the same name and a .hdr extension, anything else goes to
+    // stb_image. .f32 files are used in place without reading them up front,
+    // until the first op that changes the heights (AutoLevel included) copies
+    // them into memory. .r16 files are converted to floats in full on load
     Heightmap(const std::string &path);
 
     Heightmap(
@@ -24,11 +37,40 @@ public:
     }
 
     float At(const int x, const int y) const {
-        return m_Data[y * m_Width + x];
+        const int w = m_Width - m_Border * 2;
+        const int h = m_Height - m_Border * 2;
+        const int ix = x - m_Border;
+        const int iy = y - m_Border;
+        if (unsigned(ix) >= unsigned(w) || unsigned(iy) >= unsigned(h)) {
+            return m_BorderZ;
+        }
+        return m_Values[iy * w + ix];
     }
 
     float At(const glm::ivec2 p) const {
-        return m_Data[p.y * m_Width + p.x];
+        return At(p.x, p.y);
+    }
+
+    // bilinear interpolation between the four pixels around (x, y)
+    float Sample(const float x, const float y) const {
+        const int x0 = glm::clamp(int(x), 0, m_Width - 1);
+        const int y0 = glm::clamp(int(y), 0, m_Height - 1);
+        const int x1 = std::min(x0 + 1, m_Width - 1);
+        const int y1 = std::min(y0 + 1, m_Height - 1);
+        const float fx = x - x0;
+        const float fy = y - y0;
+        const float z0 = At(x0, y0) + (At(x1, y0) - At(x0, y0)) * fx;
+        const float z1 = At(x0, y1) + (At(x1, y1) - At(x0, y1)) * fx;
+        return z0 + (z1 - z0) * fy;
+    }
+
+    // every height, border included, is still a 16-bit code c stored as
+    // c * (1.f / 65535.f), as the loaders store them
+    bool Quantized() const;
+
+    // threads used by the pointwise ops, <= 0 for one per core
+    void SetThreadCount(const int threads) {
+        m_Threads = threads;
     }
 
     void AutoLevel();
@@ -37,25 +79,104 @@ public:
 
     void GammaCurve(const float gamma);
 
+    // replace every value v with curve(v). while the values are still the 16-bit
+    // codes the heightmap was loaded from this is one table lookup per pixel.
+    // AutoLevel and Invert give up the codes, so a curve after them is evaluated
+    // per pixel here; HeightmapPipeline tabulates such a run as a whole instead
+    void ToneCurve(const std::function<float(float)> &curve);
+
+    // the border is only stored as its size and height, pointwise ops apply to
+    // it like any other pixel and it's written out when a blur needs it
     void AddBorder(const int size, const float z);
 
     void GaussianBlur(const int r);
 
+    // same blur in place, scratch is grown to the map's size if needed and can be
+    // reused across calls and heightmaps so repeated blurs don't allocate
+    void GaussianBlur(const int r, std::vector<float> &scratch);
+
+    // writes the w values of row y, border included
+    void Row(const int y, float *row) const;
+
+    // one normal per cell between four pixels, (w - 1) x (h - 1)
     std::vector<glm::vec3> Normalmap(const float zScale) const;
 
+    // the normal map quantized to three bytes per cell, encoded row by row
+    // without the float normals, as SaveNormalmap writes it
+    std::vector<uint8_t> NormalmapRGB8(const float zScale) const;
+
+    // the normal map octahedral-encoded to two unorm16 values per cell
+    std::vector<uint16_t> NormalmapOctahedral(const float zScale) const;
+
+    // NormalmapOctahedral(zScale), kept until the heights change, another zScale is
+    // asked for or ReleaseNormalmap(), so any number of SaveHillshade calls share
+    // one pass. 4 bytes per cell instead of the 12 of Normalmap
+    std::shared_ptr<const std::vector<uint16_t>> CachedNormalmap(const float zScale) const;
+
+    // drop the cached normal map, once the hillshades are written
+    void ReleaseNormalmap() const;
+
     void SaveNormalmap(const std::string &path, const float zScale) const;
 
     void SaveHillshade(
         const std::string &path, const float zScale,
         const float altitude, const float azimuth) const;
 
+    // when built with HMM_ENABLE_STATS, the number of pixels tested is added to
+    // *pixelsRasterized. the caller owns the counter, so a heightmap shared by
+    // several triangulators keeps no state of its own
     std::pair<glm::ivec2, float> FindCandidate(
         const glm::ivec2 p0,
         const glm::ivec2 p1,
-        const glm::ivec2 p2) const;
+        const glm::ivec2 p2,
+        uint64_t *pixelsRasterized = nullptr) const;
 
 private:
-    int m_Width;
-    int m_Height;
+    friend class HeightmapPipeline;
+
+    // load a raw grid described by the sidecar header next to path
+    void LoadRaw(const std::string &path, const int bits);
+
+    // number of pixels inside the border
+    size_t Count() const {
+        return size_t(m_Width - m_Border * 2) * (m_Height - m_Border * 2);
+    }
+
+    // the pixels inside the border for writing, copied out of the mapped file
+    // the first time the heights change
+    float *Writable();
+
+    // write the border into m_Data
+    void Materialize();
+
+    // drop the rasters derived from the heights, after any change to them
+    void Invalidate();
+
+    // calls fn(y, nx, ny, nz) with the w - 1 normals of each row of cells,
+    // rows are spread over threads
+    template <class Fn>
+    void ForEachNormalRow(const float zScale, const Fn &fn) const;
+
+    // size including the border
+    int m_Width = 0;
+    int m_Height = 0;
+
+    // the pixels inside the border, read through m_Values which points either
+    // at m_Data or into m_Mapping
     std::vector<float> m_Data;
+    std::shared_ptr<const MappedFile> m_Mapping;
+    const float *m_Values = nullptr;
+
+    // virtual border around m_Values, every pixel of it is m_BorderZ
+    int m_Border = 0;
+    float m_BorderZ = 0;
+
+    // every value in m_Values is still one of the 16-bit codes it was loaded as
+    bool m_Quantized = false;
+
+    int m_Threads = 0;
+
+    mutable std::mutex m_CacheMutex;
+    mutable std::shared_ptr<const std::vector<uint16_t>> m_Normals;
+    mutable float m_NormalsZScale = 0;
 };
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// point insertion into a halfedge triangulation, shared by Triangulator and
+// DelaunayMesh so both split and flip the same way. Mesh befriends this class and
+// provides m_Points, m_Triangles, m_Halfedges and
+//   int AddTriangle(a, b, c, ab, bc, ca, e), which writes slot e or a new one
+//   void BeforeCollinearSplit(t), called before triangle t (-1 on the hull) is split
+//   void BeforeFlip(t0, t1), called before the pair of triangles is flipped
+template <class Mesh>
+class DelaunayInsertion
+{
+protected:
+    // insert point pn, which lies inside or on an edge of triangle slot t, and
+    // restore the Delaunay condition
+    void Insert(const int pn, const int t);
+
+    // split the triangles on both sides of halfedge a, which pn lies on
+    void InsertCollinear(const int pn, const int a);
+
+    void Legalize(const int a);
+
+    static bool Collinear(const glm::ivec2 p0, const glm::ivec2 p1, const glm::ivec2 p2)
+    {
+        return (p1.y - p0.y) * (p2.x - p1.x) == (p2.y - p1.y) * (p1.x - p0.x);
+    }
+
+    // p strictly inside the circumcircle of triangle (a, b, c), in triangle winding
+    static bool InCircle(const glm::ivec2 a, const glm::ivec2 b, const glm::ivec2 c, const glm::ivec2 p)
+    {
+        const int64_t dx = a.x - p.x;
+        const int64_t dy = a.y - p.y;
+        const int64_t ex = b.x - p.x;
+        const int64_t ey = b.y - p.y;
+        const int64_t fx = c.x - p.x;
+        const int64_t fy = c.y - p.y;
+        const int64_t ap = dx * dx + dy * dy;
+        const int64_t bp = ex * ex + ey * ey;
+        const int64_t cp = fx * fx + fy * fy;
+        return dx * (ey * cp - bp * fy) - dy * (ex * cp - bp * fx) + ap * (ex * fy - ey * fx) < 0;
+    }
+
+private:
+    Mesh& Self()
+    {
+        return static_cast<Mesh&>(*this);
+    }
+};
+
+template <class Mesh>
+void DelaunayInsertion<Mesh>::Insert(const int pn, const int t)
+{
+    Mesh& mesh = Self();
+
+    const int e0 = t * 3 + 0;
+    const int e1 = t * 3 + 1;
+    const int e2 = t * 3 + 2;
+
+    const int p0 = mesh.m_Triangles[e0];
+    const int p1 = mesh.m_Triangles[e1];
+    const int p2 = mesh.m_Triangles[e2];
+
+    const glm::ivec2 a = mesh.m_Points[p0];
+    const glm::ivec2 b = mesh.m_Points[p1];
+    const glm::ivec2 c = mesh.m_Points[p2];
+    const glm::ivec2 p = mesh.m_Points[pn];
+
+    if (Collinear(a, b, p))
+    {
+        InsertCollinear(pn, e0);
+    }
+    else if (Collinear(b, c, p))
+    {
+        InsertCollinear(pn, e1);
+    }
+    else if (Collinear(c, a, p))
+    {
+        InsertCollinear(pn, e2);
+    }
+    else
+    {
+        const int h0 = mesh.m_Halfedges[e0];
+        const int h1 = mesh.m_Halfedges[e1];
+        const int h2 = mesh.m_Halfedges[e2];
+
+        const int t0 = mesh.AddTriangle(p0, p1, pn, h0, -1, -1, e0);
+        const int t1 = mesh.AddTriangle(p1, p2, pn, h1, -1, t0 + 1, -1);
+        const int t2 = mesh.AddTriangle(p2, p0, pn, h2, t0 + 2, t1 + 1, -1);
+
+        Legalize(t0);
+        Legalize(t1);
+        Legalize(t2);
+    }
+}
+
+template <class Mesh>
+void DelaunayInsertion<Mesh>::InsertCollinear(const int pn, const int a)
+{
+    Mesh& mesh = Self();
+
+    const int a0 = a - a % 3;
+    const int al = a0 + (a + 1) % 3;
+    const int ar = a0 + (a + 2) % 3;
+    const int p0 = mesh.m_Triangles[ar];
+    const int pr = mesh.m_Triangles[a];
+    const int pl = mesh.m_Triangles[al];
+    const int hal = mesh.m_Halfedges[al];
+    const int har = mesh.m_Halfedges[ar];
+
+    const int b = mesh.m_Halfedges[a];
+
+    if (b < 0)
+    {
+        mesh.BeforeCollinearSplit(-1);
+        const int t0 = mesh.AddTriangle(pn, p0, pr, -1, har, -1, a0);
+        const int t1 = mesh.AddTriangle(p0, pn, pl, t0, -1, hal, -1);
+        Legalize(t0 + 1);
+        Legalize(t1 + 2);
+        return;
+    }
+
+    const int b0 = b - b % 3;
+    const int bl = b0 + (b + 2) % 3;
+    const int br = b0 + (b + 1) % 3;
+    const int p1 = mesh.m_Triangles[bl];
+    const int hbl = mesh.m_Halfedges[bl];
+    const int hbr = mesh.m_Halfedges[br];
+
+    mesh.BeforeCollinearSplit(b / 3);
+
+    const int t0 = mesh.AddTriangle(p0, pr, pn, har, -1, -1, a0);
+    const int t1 = mesh.AddTriangle(pr, p1, pn, hbr, -1, t0 + 1, b0);
+    const int t2 = mesh.AddTriangle(p1, pl, pn, hbl, -1, t1 + 1, -1);
+    const int t3 = mesh.AddTriangle(pl, p0, pn, hal, t0 + 2, t2 + 1, -1);
+
+    Legalize(t0);
+    Legalize(t1);
+    Legalize(t2);
+    Legalize(t3);
+}
+
+template <class Mesh>
+void DelaunayInsertion<Mesh>::Legalize(const int a)
+{
+    // if the pair of triangles doesn't satisfy the Delaunay condition
+    // (p1 is inside the circumcircle of [p0, pl, pr]), flip them,
+    // then do the same check/flip recursively for the new pair of triangles
+    //
+    //           pl                    pl
+    //          /||\                  /  \
+    //       al/ || \bl            al/    \a
+    //        /  ||  \              /      \
+    //       /  a||b  \    flip    /___ar___\
+    //     p0\   ||   /p1   =>   p0\---bl---/p1
+    //        \  ||  /              \      /
+    //       ar\ || /br             b\    /br
+    //          \||/                  \  /
+    //           pr                    pr
+
+    Mesh& mesh = Self();
+
+    const int b = mesh.m_Halfedges[a];
+
+    if (b < 0)
+    {
+        return;
+    }
+
+    const int a0 = a - a % 3;
+    const int b0 = b - b % 3;
+    const int al = a0 + (a + 1) % 3;
+    const int ar = a0 + (a + 2) % 3;
+    const int bl = b0 + (b + 2) % 3;
+    const int br = b0 + (b + 1) % 3;
+    const int p0 = mesh.m_Triangles[ar];
+    const int pr = mesh.m_Triangles[a];
+    const int pl = mesh.m_Triangles[al];
+    const int p1 = mesh.m_Triangles[bl];
+
+    if (!InCircle(mesh.m_Points[p0], mesh.m_Points[pr], mesh.m_Points[pl], mesh.m_Points[p1]))
+    {
+        return;
+    }
+
+    const int hal = mesh.m_Halfedges[al];
+    const int har = mesh.m_Halfedges[ar];
+    const int hbl = mesh.m_Halfedges[bl];
+    const int hbr = mesh.m_Halfedges[br];
+
+    mesh.BeforeFlip(a / 3, b / 3);
+
+    const int t0 = mesh.AddTriangle(p0, p1, pl, -1, hbl, hal, a0);
+    const int t1 = mesh.AddTriangle(p1, p0, pr, t0, har, hbr, b0);
+
+    Legalize(t0 + 1);
+    Legalize(t1 + 2);
+}
@@ -0,0 +1,192 @@
+#include "lod.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "trace.h"
+
+LodSelector::LodSelector(const Triangulator& tri, const float zScale)
+{
+    m_Points = tri.Points(zScale);
+    m_Parent = tri.MorphTargets();
+    const std::vector<float>& errors = tri.InsertionErrors();
+    const int n = m_Points.size();
+
+    // children in insertion order
+    m_Child.assign(n, -1);
+    m_Sibling.assign(n, -1);
+    for (int i = n - 1; i >= 4; --i)
+    {
+        m_Sibling[i] = m_Child[m_Parent[i]];
+        m_Child[m_Parent[i]] = i;
+    }
+
+    // children are always inserted after their parent, so walking backwards
+    // finishes every subtree before its root
+    m_Error.resize(n);
+    m_Radius.assign(n, 0);
+    for (int i = n - 1; i >= 0; --i)
+    {
+        m_Error[i] = errors[i] * zScale;
+        for (int c = m_Child[i]; c >= 0; c = m_Sibling[c])
+        {
+            m_Error[i] = std::max(m_Error[i], m_Error[c]);
+            m_Radius[i] = std::max(m_Radius[i], glm::length(m_Points[c] - m_Points[i]) + m_Radius[c]);
+        }
+    }
+
+    for (const glm::ivec2& p : tri.PixelPoints())
+    {
+        m_Mesh.AddPoint(p);
+    }
+
+    m_Active.assign(n, 0);
+    m_ActiveChildren.assign(n, 0);
+    m_ActiveIndex.assign(n, -1);
+    if (n < 4)
+    {
+        return;
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        m_Active[i] = 1;
+        m_ActiveIndex[i] = i;
+        m_ActiveList.push_back(i);
+    }
+    m_Mesh.InitializeCorners(0, 1, 2, 3);
+    m_Stats.ActivePoints = m_ActiveList.size();
+    m_Stats.Triangles = m_Mesh.NumTriangles();
+}
+
+const LodFrameStats& LodSelector::Select(const glm::vec3& eye, const float pixelScale, const float tolerance)
+{
+    HMM_TRACE_SCOPE("LodSelector::Select");
+    const auto start = std::chrono::steady_clock::now();
+
+    m_Stats = LodFrameStats();
+    m_Mesh.ClearChangedTriangles();
+
+    // collapse active leaves that are no longer needed, then their parents
+    m_Stack.clear();
+    for (const int i : m_ActiveList)
+    {
+        if (m_ActiveChildren[i] == 0 && !Needed(i, eye, pixelScale, tolerance))
+        {
+            m_Stack.push_back(i);
+        }
+    }
+    while (!m_Stack.empty())
+    {
+        const int i = m_Stack.back();
+        m_Stack.pop_back();
+        Deactivate(i);
+        const int p = m_Parent[i];
+        if (m_ActiveChildren[p] == 0 && !Needed(p, eye, pixelScale, tolerance))
+        {
+            m_Stack.push_back(p);
+        }
+    }
+
+    // expand below the remaining active points
+    m_Stack.assign(m_ActiveList.begin(), m_ActiveList.end());
+    while (!m_Stack.empty())
+    {
+        const int i = m_Stack.back();
+        m_Stack.pop_back();
+        for (int c = m_Child[i]; c >= 0; c = m_Sibling[c])
+        {
+            if (!m_Active[c] && Needed(c, eye, pixelScale, tolerance))
+            {
+                Activate(c);
+                m_Stack.push_back(c);
+            }
+        }
+    }
+
+    m_Stats.ActivePoints = m_ActiveList.size();
+    m_Stats.Triangles = m_Mesh.NumTriangles();
+    m_Stats.UpdatedTriangles = m_Mesh.ChangedTriangles().size();
+    m_Stats.Milliseconds = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return m_Stats;
+}
+
+bool LodSelector::Needed(const int i, const glm::vec3& eye, const float pixelScale, const float tolerance) const
+{
+    // the corners hold the mesh together
+    if (i < 4)
+    {
+        return true;
+    }
+    const float distance = glm::length(m_Points[i] - eye) - m_Radius[i];
+    return m_Error[i] * pixelScale > tolerance * std::max(distance, 0.0f);
+}
+
+void LodSelector::Activate(const int i)
+{
+    // the parent is active, so the walk starts right next to the new point
+    const int p = m_Parent[i];
+    m_Mesh.Insert(i, m_Mesh.Locate(m_Mesh.Points()[i], m_Mesh.PointTriangle(p)));
+
+    m_Active[i] = 1;
+    m_ActiveIndex[i] = m_ActiveList.size();
+    m_ActiveList.push_back(i);
+    m_ActiveChildren[p]++;
+    m_Stats.Activated++;
+}
+
+void LodSelector::Deactivate(const int i)
+{
+    m_Mesh.Remove(i);
+
+    const int last = m_ActiveList.back();
+    m_ActiveList[m_ActiveIndex[i]] = last;
+    m_ActiveIndex[last] = m_ActiveIndex[i];
+    m_ActiveList.pop_back();
+    m_ActiveIndex[i] = -1;
+    m_Active[i] = 0;
+    m_ActiveChildren[m_Parent[i]]--;
+    m_Stats.Deactivated++;
+}
+
+std::vector<glm::vec3> LodFlightPath(const int width, const int height, const float altitude, const int frames)
+{
+    const glm::vec2 center(0.5f * (width - 1), 0.5f * (height - 1));
+    const float size = std::max(width, height);
+    const int spiral = frames / 2;
+
+    std::vector<glm::vec3> eyes;
+    eyes.reserve(frames);
+    for (int i = 0; i < spiral; ++i)
+    {
+        const float s = float(i) / spiral;
+        const float angle = 4 * 3.14159265f * s;
+        const float radius = 0.5f * size * (1 - s);
+        eyes.emplace_back(
+            center + radius * glm::vec2(std::cos(angle), std::sin(angle)),
+            altitude + 2 * size * (1 - s));
+    }
+    for (int i = spiral; i < frames; ++i)
+    {
+        const float s = frames - spiral > 1 ? float(i - spiral) / (frames - spiral - 1) : 0.0f;
+        eyes.emplace_back(center.x, center.y + (height - 1 - center.y) * s, altitude);
+    }
+    return eyes;
+}
+
+std::vector<LodFrameStats> ReplayLodPath(
+    const Triangulator& tri, const float zScale, const std::vector<glm::vec3>& eyes,
+    const float pixelScale, const float tolerance)
+{
+    HMM_TRACE_SCOPE("ReplayLodPath");
+
+    LodSelector lod(tri, zScale);
+    std::vector<LodFrameStats> frames;
+    frames.reserve(eyes.size());
+    for (const glm::vec3& eye : eyes)
+    {
+        frames.push_back(lod.Select(eye, pixelScale, tolerance));
+    }
+    return frames;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "delaunay.h"
+#include "triangulator.h"
+
+struct LodFrameStats
+{
+    int Activated = 0;
+    int Deactivated = 0;
+    int ActivePoints = 0;
+    int Triangles = 0;
+    // triangle slots written or freed by this frame's changes
+    int UpdatedTriangles = 0;
+    double Milliseconds = 0;
+};
+
+// view-dependent level of detail over a finished triangulation. every point hangs
+// off its morph target and is only active while its parent is. the output is the
+// Delaunay triangulation of the active points, updated by inserting and removing
+// the points whose state changed, so it has no cracks or fold-overs
+class LodSelector
+{
+public:
+    // snapshot of tri's points and hierarchy, starting from the four corners
+    LodSelector(const Triangulator& tri, const float zScale);
+
+    // activate every point whose subtree's error projects to more than tolerance
+    // pixels from eye (same space as Triangulator::Points), and collapse the rest.
+    // pixelScale is the viewport height / (2 tan(fovY / 2)). starts from the previous
+    // frame's selection, so only the active points and their children are tested
+    // and only the triangles around the points that changed are rewritten
+    const LodFrameStats& Select(const glm::vec3& eye, const float pixelScale, const float tolerance);
+
+    // every point of the triangulation, only the active ones are referenced
+    const std::vector<glm::vec3>& Points() const
+    {
+        return m_Points;
+    }
+
+    // point indices of every triangle slot, unused slots are degenerate
+    const std::vector<int>& TriangleIndices() const
+    {
+        return m_Mesh.TriangleIndices();
+    }
+
+    // slots changed by the last Select()
+    const std::vector<int>& ChangedTriangles() const
+    {
+        return m_Mesh.ChangedTriangles();
+    }
+
+    std::vector<glm::ivec3> Triangles() const
+    {
+        return m_Mesh.Triangles();
+    }
+
+    bool IsActive(const int i) const
+    {
+        return m_Active[i] != 0;
+    }
+
+    const LodFrameStats& Stats() const
+    {
+        return m_Stats;
+    }
+
+private:
+    bool Needed(const int i, const glm::vec3& eye, const float pixelScale, const float tolerance) const;
+
+    void Activate(const int i);
+    void Deactivate(const int i);
+
+    std::vector<glm::vec3> m_Points;
+    std::vector<int> m_Parent;
+    std::vector<int> m_Child;
+    std::vector<int> m_Sibling;
+
+    // largest insertion error in each point's subtree, and a radius around the
+    // point that contains the subtree, so a point is never needed unless its parent is
+    std::vector<float> m_Error;
+    std::vector<float> m_Radius;
+
+    std::vector<uint8_t> m_Active;
+    std::vector<int> m_ActiveChildren;
+    std::vector<int> m_ActiveList;
+    std::vector<int> m_ActiveIndex;
+    std::vector<int> m_Stack;
+
+    DelaunayMesh m_Mesh;
+
+    LodFrameStats m_Stats;
+};
+
+// eye positions of a synthetic flight over a width x height triangulation, in the
+// space of Triangulator::Points: a spiral from high above the whole terrain down to
+// altitude over the center, then straight on to the far edge
+std::vector<glm::vec3> LodFlightPath(const int width, const int height, const float altitude, const int frames);
+
+// replay eyes through a fresh selector over tri without rendering anything, and
+// return every frame's stats, including how long its Select() took
+std::vector<LodFrameStats> ReplayLodPath(
+    const Triangulator& tri, const float zScale, const std::vector<glm::vec3>& eyes,
+    const float pixelScale, const float tolerance);
@@ -0,0 +1,77 @@
+#include "mapped.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// the view keeps the file open, so the handles are closed as soon as it exists
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path) {
+    const HANDLE file = CreateFileA(
+        path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return;
+    }
+    const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        return;
+    }
+    const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) {
+        return;
+    }
+    m_Data = static_cast<const uint8_t *>(view);
+    m_Size = static_cast<size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    if (m_Data) {
+        UnmapViewOfFile(m_Data);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+        close(file);
+        return;
+    }
+    void *view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (view == MAP_FAILED) {
+        return;
+    }
+    m_Data = static_cast<const uint8_t *>(view);
+    m_Size = static_cast<size_t>(info.st_size);
+}
+
+MappedFile::~MappedFile() {
+    if (m_Data) {
+        munmap(const_cast<uint8_t *>(m_Data), m_Size);
+    }
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// a whole file mapped read-only into memory. nothing is read up front, each page
+// is loaded from disk the first time it's touched
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // nullptr if the file couldn't be opened or mapped, or is empty
+    const uint8_t *Data() const {
+        return m_Data;
+    }
+
+    size_t Size() const {
+        return m_Size;
+    }
+
+private:
+    const uint8_t *m_Data = nullptr;
+    size_t m_Size = 0;
+};
@@ -0,0 +1,95 @@
+#include "meshbuffer.h"
+
+#include <algorithm>
+
+void MeshBuffer::AppendVertices(const Triangulator& tri)
+{
+    const std::vector<glm::ivec2>& points = tri.PixelPoints();
+    const Heightmap& hm = *tri.GetHeightmap();
+    m_Vertices.reserve(points.size());
+    for (int i = m_Vertices.size(); i < points.size(); ++i)
+    {
+        const glm::ivec2 p = points[i];
+        m_Vertices.emplace_back(p.x, hm.At(p) * m_ZScale, p.y);
+    }
+}
+
+bool MeshBuffer::Update(Triangulator& tri, const float zScale)
+{
+    const std::vector<int>& triangles = tri.TriangleIndices();
+
+    if (m_Lod || tri.Revision() != m_Revision || zScale != m_ZScale)
+    {
+        m_Lod = nullptr;
+        m_Revision = tri.Revision();
+        m_ZScale = zScale;
+        m_Vertices.clear();
+        AppendVertices(tri);
+        m_Indices.assign(triangles.begin(), triangles.end());
+        m_DirtyVertices = { 0, static_cast<int>(m_Vertices.size()) };
+        m_DirtyIndices.assign(1, { 0, static_cast<int>(m_Indices.size()) });
+        tri.ClearChangedTriangles();
+        tri.TrackChanges(true);
+        return true;
+    }
+
+    const int vertexCount = m_Vertices.size();
+    AppendVertices(tri);
+    m_DirtyVertices = { vertexCount, static_cast<int>(m_Vertices.size()) };
+
+    // new slots are always reported as changed, so growing first and patching
+    // the changed slots covers both
+    m_Indices.resize(triangles.size());
+    PatchSlots(triangles, tri.ChangedTriangles());
+    tri.ClearChangedTriangles();
+    return false;
+}
+
+bool MeshBuffer::Update(const LodSelector& lod)
+{
+    const std::vector<int>& triangles = lod.TriangleIndices();
+
+    if (m_Lod != &lod)
+    {
+        // a triangulator update after this one has to rebuild
+        m_Lod = &lod;
+        m_Revision = 0;
+        m_Vertices.clear();
+        m_Vertices.reserve(lod.Points().size());
+        for (const glm::vec3& p : lod.Points())
+        {
+            m_Vertices.emplace_back(p.x, p.z, p.y);
+        }
+        m_Indices.assign(triangles.begin(), triangles.end());
+        m_DirtyVertices = { 0, static_cast<int>(m_Vertices.size()) };
+        m_DirtyIndices.assign(1, { 0, static_cast<int>(m_Indices.size()) });
+        return true;
+    }
+
+    m_DirtyVertices = {};
+    m_Indices.resize(triangles.size());
+    PatchSlots(triangles, lod.ChangedTriangles());
+    return false;
+}
+
+void MeshBuffer::PatchSlots(const std::vector<int>& triangles, const std::vector<int>& slots)
+{
+    m_ChangedSlots.assign(slots.begin(), slots.end());
+    std::sort(m_ChangedSlots.begin(), m_ChangedSlots.end());
+    m_DirtyIndices.clear();
+    for (const int t : m_ChangedSlots)
+    {
+        const int e = t * 3;
+        m_Indices[e + 0] = triangles[e + 0];
+        m_Indices[e + 1] = triangles[e + 1];
+        m_Indices[e + 2] = triangles[e + 2];
+        if (!m_DirtyIndices.empty() && m_DirtyIndices.back().End == e)
+        {
+            m_DirtyIndices.back().End = e + 3;
+        }
+        else
+        {
+            m_DirtyIndices.push_back({ e, e + 3 });
+        }
+    }
+}
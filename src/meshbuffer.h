@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "lod.h"
+#include "triangulator.h"
+
+// half-open range of elements written by the last MeshBuffer::Update
+struct DirtyRange
+{
+    int Begin = 0;
+    int End = 0;
+
+    bool Empty() const
+    {
+        return Begin >= End;
+    }
+};
+
+// persistent, GPU-ready copy of a triangulation that follows it incrementally.
+// points are append-only, so each update only converts the new points and
+// rewrites the index slots of triangles the triangulator reports as changed.
+// a full rebuild only happens after Initialize/ReverseStep, a new zScale or a
+// switch between following a triangulation and a LodSelector
+class MeshBuffer
+{
+public:
+    // returns true if the buffer was rebuilt from scratch
+    bool Update(Triangulator& tri, const float zScale);
+
+    // follow a LodSelector instead, call after each Select(). its points never
+    // change, so only the triangle slots the last Select() touched are rewritten.
+    // returns true if the buffer was rebuilt from scratch
+    bool Update(const LodSelector& lod);
+
+    // force the next Update to rebuild, e.g. after the consumer's copy was overwritten
+    void Invalidate()
+    {
+        m_Revision = 0;
+        m_Lod = nullptr;
+    }
+
+    // y-up (x, height * zScale, y) positions, laid out like DirectX::VertexPosition
+    const std::vector<glm::vec3>& Vertices() const
+    {
+        return m_Vertices;
+    }
+
+    // three indices per triangle slot of Triangulator::TriangleIndices()
+    const std::vector<uint32_t>& Indices() const
+    {
+        return m_Indices;
+    }
+
+    DirtyRange DirtyVertices() const
+    {
+        return m_DirtyVertices;
+    }
+
+    // sorted, non-overlapping index ranges, one per run of adjacent changed slots
+    const std::vector<DirtyRange>& DirtyIndices() const
+    {
+        return m_DirtyIndices;
+    }
+
+private:
+    void AppendVertices(const Triangulator& tri);
+
+    // copy the given slots of triangles into m_Indices and record them as dirty
+    void PatchSlots(const std::vector<int>& triangles, const std::vector<int>& slots);
+
+    std::vector<glm::vec3> m_Vertices;
+    std::vector<uint32_t> m_Indices;
+    DirtyRange m_DirtyVertices;
+    std::vector<DirtyRange> m_DirtyIndices;
+    std::vector<int> m_ChangedSlots;
+
+    uint64_t m_Revision = 0;
+    float m_ZScale = 0;
+    // the selector followed by the last Update, null while following a triangulator
+    const LodSelector* m_Lod = nullptr;
+};
@@ -0,0 +1,232 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <tuple>
+
+#include "trace.h"
+
+namespace {
+
+void ComputeBounds(
+    Meshlet &m, const Meshlets &result,
+    const std::vector<glm::vec3> &points)
+{
+    // sphere around the bounding box center
+    glm::vec3 lo = points[result.Vertices[m.VertexOffset]];
+    glm::vec3 hi = lo;
+    for (uint32_t i = 0; i < m.VertexCount; i++) {
+        const glm::vec3 &p = points[result.Vertices[m.VertexOffset + i]];
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    m.Center = (lo + hi) * 0.5f;
+    float r2 = 0;
+    for (uint32_t i = 0; i < m.VertexCount; i++) {
+        const glm::vec3 d = points[result.Vertices[m.VertexOffset + i]] - m.Center;
+        r2 = std::max(r2, glm::dot(d, d));
+    }
+    m.Radius = std::sqrt(r2);
+
+    // normal cone around the average triangle normal. the normals are computed
+    // again for the cutoff rather than kept, since maxTriangles has no bound
+    const auto normal = [&](const uint32_t i) {
+        const uint8_t *t = &result.Triangles[size_t(m.TriangleOffset + i) * 3];
+        const glm::vec3 &a = points[result.Vertices[m.VertexOffset + t[0]]];
+        const glm::vec3 &b = points[result.Vertices[m.VertexOffset + t[1]]];
+        const glm::vec3 &c = points[result.Vertices[m.VertexOffset + t[2]]];
+        const glm::vec3 n = glm::cross(b - a, c - a);
+        const float len = glm::length(n);
+        return len > 0 ? n / len : glm::vec3(0);
+    };
+    glm::vec3 sum(0);
+    for (uint32_t i = 0; i < m.TriangleCount; i++) {
+        sum += normal(i);
+    }
+    const float len = glm::length(sum);
+    if (len <= 0) {
+        m.ConeAxis = glm::vec3(0, 0, 1);
+        m.ConeCutoff = -1;
+        return;
+    }
+    m.ConeAxis = sum / len;
+    m.ConeCutoff = 1;
+    for (uint32_t i = 0; i < m.TriangleCount; i++) {
+        m.ConeCutoff = std::min(m.ConeCutoff, glm::dot(normal(i), m.ConeAxis));
+    }
+}
+
+}
+
+Meshlets BuildMeshlets(
+    const std::vector<glm::vec3> &points,
+    const std::vector<int> &triangles,
+    const std::vector<int> &halfedges,
+    int maxVertices, const int maxTriangles)
+{
+    HMM_TRACE_SCOPE("BuildMeshlets");
+
+    maxVertices = std::min(maxVertices, 256);
+    const int n = triangles.size() / 3;
+
+    Meshlets result;
+    if (n == 0 || maxVertices < 3 || maxTriangles < 1) {
+        return result;
+    }
+    const int estimate = n / std::min(maxTriangles, maxVertices) + 1;
+    result.Clusters.reserve(estimate);
+    result.Vertices.reserve(n);
+    result.Triangles.reserve(n * 3);
+
+    std::vector<bool> assigned(n, false);
+    // cluster-local index of each point, valid while owner matches the cluster
+    std::vector<int> owner(points.size(), -1);
+    std::vector<uint8_t> local(points.size(), 0);
+    // frontier triangles bucketed by how many vertices they would add,
+    // each bucket is FIFO so clusters grow outwards rather than in strips
+    std::array<std::deque<int>, 4> frontier;
+    std::vector<int> leftover;
+    int cursor = 0;
+
+    const auto newVertices = [&](const int t, const int cluster) {
+        int count = 0;
+        for (int j = 0; j < 3; j++) {
+            count += owner[triangles[t * 3 + j]] != cluster;
+        }
+        return count;
+    };
+
+    while (true) {
+        // seed next to the previous cluster where possible, to keep clusters compact
+        int seed = -1;
+        while (seed < 0 && !leftover.empty()) {
+            if (!assigned[leftover.back()]) {
+                seed = leftover.back();
+            }
+            leftover.pop_back();
+        }
+        while (seed < 0 && cursor < n) {
+            if (!assigned[cursor]) {
+                seed = cursor;
+            }
+            cursor++;
+        }
+        if (seed < 0) {
+            break;
+        }
+        leftover.clear();
+
+        const int cluster = result.Clusters.size();
+        Meshlet m = {};
+        m.VertexOffset = result.Vertices.size();
+        m.TriangleOffset = result.Triangles.size() / 3;
+        frontier[0].push_back(seed);
+
+        while (m.TriangleCount < uint32_t(maxTriangles)) {
+            int t = -1;
+            for (auto &bucket : frontier) {
+                while (t < 0 && !bucket.empty()) {
+                    if (!assigned[bucket.front()]) {
+                        t = bucket.front();
+                    }
+                    bucket.pop_front();
+                }
+                if (t >= 0) {
+                    break;
+                }
+            }
+            if (t < 0) {
+                break;
+            }
+            if (m.VertexCount + newVertices(t, cluster) > uint32_t(maxVertices)) {
+                leftover.push_back(t);
+                continue;
+            }
+
+            assigned[t] = true;
+            for (int j = 0; j < 3; j++) {
+                const int v = triangles[t * 3 + j];
+                if (owner[v] != cluster) {
+                    owner[v] = cluster;
+                    local[v] = m.VertexCount++;
+                    result.Vertices.push_back(v);
+                }
+                result.Triangles.push_back(local[v]);
+            }
+            m.TriangleCount++;
+
+            // neighbours across each edge
+            for (int j = 0; j < 3; j++) {
+                const int h = halfedges[t * 3 + j];
+                if (h >= 0 && !assigned[h / 3]) {
+                    const int u = h / 3;
+                    frontier[newVertices(u, cluster)].push_back(u);
+                }
+            }
+        }
+
+        for (auto &bucket : frontier) {
+            leftover.insert(leftover.end(), bucket.begin(), bucket.end());
+            bucket.clear();
+        }
+
+        ComputeBounds(m, result, points);
+        result.Clusters.push_back(m);
+    }
+
+    return result;
+}
+
+bool VerifyMeshlets(
+    const Meshlets &meshlets,
+    const std::vector<int> &triangles,
+    int maxVertices, const int maxTriangles)
+{
+    maxVertices = std::min(maxVertices, 256);
+
+    // every triangle rotated to start at its smallest index, so the same
+    // triangle compares equal whichever corner a cluster lists first
+    const auto canonical = [](const int a, const int b, const int c) {
+        if (a < b && a < c) {
+            return glm::ivec3(a, b, c);
+        }
+        if (b < c) {
+            return glm::ivec3(b, c, a);
+        }
+        return glm::ivec3(c, a, b);
+    };
+    const auto less = [](const glm::ivec3 &a, const glm::ivec3 &b) {
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    };
+
+    std::vector<glm::ivec3> expected;
+    expected.reserve(triangles.size() / 3);
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+        expected.push_back(canonical(triangles[i], triangles[i + 1], triangles[i + 2]));
+    }
+
+    std::vector<glm::ivec3> actual;
+    actual.reserve(expected.size());
+    for (const Meshlet &m : meshlets.Clusters) {
+        if (m.VertexCount > uint32_t(maxVertices) ||
+            m.TriangleCount > uint32_t(maxTriangles) ||
+            size_t(m.VertexOffset) + m.VertexCount > meshlets.Vertices.size() ||
+            (size_t(m.TriangleOffset) + m.TriangleCount) * 3 > meshlets.Triangles.size())
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < m.TriangleCount; i++) {
+            const uint8_t *t = &meshlets.Triangles[size_t(m.TriangleOffset + i) * 3];
+            if (t[0] >= m.VertexCount || t[1] >= m.VertexCount || t[2] >= m.VertexCount) {
+                return false;
+            }
+            const uint32_t *v = &meshlets.Vertices[m.VertexOffset];
+            actual.push_back(canonical(v[t[0]], v[t[1]], v[t[2]]));
+        }
+    }
+
+    std::sort(expected.begin(), expected.end(), less);
+    std::sort(actual.begin(), actual.end(), less);
+    return actual == expected;
+}
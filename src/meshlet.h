@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Meshlet {
+    // ranges into Meshlets::Vertices and Meshlets::Triangles (in triangles)
+    uint32_t VertexOffset;
+    uint32_t VertexCount;
+    uint32_t TriangleOffset;
+    uint32_t TriangleCount;
+
+    glm::vec3 Center;
+    float Radius;
+
+    // every triangle normal lies within acos(ConeCutoff) of ConeAxis.
+    // a cutoff <= 0 means the cluster can't be cone culled
+    glm::vec3 ConeAxis;
+    float ConeCutoff;
+};
+
+struct Meshlets {
+    std::vector<Meshlet> Clusters;
+    // global point index of each cluster-local vertex
+    std::vector<uint32_t> Vertices;
+    // three cluster-local vertex indices per triangle
+    std::vector<uint8_t> Triangles;
+};
+
+// partition a triangulation into clusters of at most maxVertices (<= 256) vertices
+// and maxTriangles triangles, grown over the halfedge adjacency so clusters stay
+// connected and compact. triangles and halfedges are in Triangulator slot layout
+Meshlets BuildMeshlets(
+    const std::vector<glm::vec3> &points,
+    const std::vector<int> &triangles,
+    const std::vector<int> &halfedges,
+    int maxVertices, const int maxTriangles);
+
+// check that meshlets holds every triangle exactly once, with the winding kept
+// and every cluster within the limits BuildMeshlets was given
+bool VerifyMeshlets(
+    const Meshlets &meshlets,
+    const std::vector<int> &triangles,
+    int maxVertices, const int maxTriangles);
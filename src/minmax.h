@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+// lo/hi widened to the n values, with the same a < b ? a : b comparisons per
+// lane as std::min/std::max, so NaNs are skipped like in a scalar loop. the lanes
+// can disagree with a scalar loop about the sign of a zero extreme, callers that
+// care look for the first zero themselves
+inline void MinMax(const float *data, const int n, float &lo, float &hi) {
+    int i = 0;
+#if defined(__SSE__) || defined(_M_X64)
+    __m128 l0 = _mm_set1_ps(lo);
+    __m128 l1 = l0;
+    __m128 h0 = _mm_set1_ps(hi);
+    __m128 h1 = h0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128 v0 = _mm_loadu_ps(data + i);
+        const __m128 v1 = _mm_loadu_ps(data + i + 4);
+        l0 = _mm_min_ps(v0, l0);
+        l1 = _mm_min_ps(v1, l1);
+        h0 = _mm_max_ps(v0, h0);
+        h1 = _mm_max_ps(v1, h1);
+    }
+    float l[8];
+    float h[8];
+    _mm_storeu_ps(l, l0);
+    _mm_storeu_ps(l + 4, l1);
+    _mm_storeu_ps(h, h0);
+    _mm_storeu_ps(h + 4, h1);
+    for (int k = 0; k < 8; k++) {
+        lo = std::min(lo, l[k]);
+        hi = std::max(hi, h[k]);
+    }
+#endif
+    for (; i < n; i++) {
+        lo = std::min(lo, data[i]);
+        hi = std::max(hi, data[i]);
+    }
+}
@@ -0,0 +1,172 @@
+#include "ordering.h"
+
+#include "trace.h"
+
+CacheStats MeasureVertexCache(
+    const std::vector<glm::ivec3> &triangles,
+    const int numPoints, const int cacheSize)
+{
+    // a vertex is cached if it entered the FIFO fewer than cacheSize misses ago
+    std::vector<int> entered(numPoints, -cacheSize - 1);
+    int misses = 0;
+    for (const glm::ivec3 &t : triangles) {
+        for (int i = 0; i < 3; i++) {
+            if (misses - entered[t[i]] > cacheSize) {
+                entered[t[i]] = misses++;
+            }
+        }
+    }
+
+    CacheStats stats;
+    if (!triangles.empty()) {
+        stats.Acmr = float(misses) / triangles.size();
+    }
+    if (numPoints > 0) {
+        stats.Atvr = float(misses) / numPoints;
+    }
+    return stats;
+}
+
+namespace {
+
+std::vector<int> Tipsify(
+    const std::vector<glm::ivec3> &triangles,
+    const int numPoints, const int cacheSize)
+{
+    const int n = triangles.size();
+
+    // vertex to triangle adjacency
+    std::vector<int> offsets(numPoints + 1, 0);
+    for (const glm::ivec3 &t : triangles) {
+        offsets[t.x + 1]++;
+        offsets[t.y + 1]++;
+        offsets[t.z + 1]++;
+    }
+    for (int v = 0; v < numPoints; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<int> adjacency(offsets[numPoints]);
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < n; i++) {
+        adjacency[fill[triangles[i].x]++] = i;
+        adjacency[fill[triangles[i].y]++] = i;
+        adjacency[fill[triangles[i].z]++] = i;
+    }
+
+    std::vector<int> live(numPoints);
+    for (int v = 0; v < numPoints; v++) {
+        live[v] = offsets[v + 1] - offsets[v];
+    }
+    std::vector<int> cacheTime(numPoints, 0);
+    std::vector<bool> emitted(n, false);
+    std::vector<int> deadEnd;
+    std::vector<int> candidates;
+    std::vector<int> order;
+    order.reserve(n);
+
+    int time = cacheSize + 1;
+    int cursor = 0;
+    int fan = numPoints > 0 ? 0 : -1;
+    while (fan >= 0) {
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (int i = offsets[fan]; i < offsets[fan + 1]; i++) {
+            const int t = adjacency[i];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = true;
+            order.push_back(t);
+            for (int j = 0; j < 3; j++) {
+                const int v = triangles[t][j];
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                }
+            }
+        }
+
+        // next fan: the candidate that stays in the cache the longest while
+        // its remaining triangles are emitted
+        int next = -1;
+        int best = -1;
+        for (const int v : candidates) {
+            if (live[v] <= 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        // dead end: fall back to recently used vertices, then to input order
+        while (next < 0 && !deadEnd.empty()) {
+            const int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) {
+                next = v;
+            }
+        }
+        while (next < 0 && cursor < numPoints) {
+            if (live[cursor] > 0) {
+                next = cursor;
+            }
+            cursor++;
+        }
+        fan = next;
+    }
+    return order;
+}
+
+}
+
+OrderingStats OptimizeMeshOrder(
+    std::vector<glm::vec3> &points,
+    std::vector<glm::ivec3> &triangles,
+    const int cacheSize)
+{
+    HMM_TRACE_SCOPE("OptimizeMeshOrder");
+
+    const int numPoints = points.size();
+    OrderingStats stats;
+    stats.Before = MeasureVertexCache(triangles, numPoints, cacheSize);
+
+    const std::vector<int> order = Tipsify(triangles, numPoints, cacheSize);
+
+    // renumber points in the order the reordered triangles first use them,
+    // unreferenced points keep their relative order at the end
+    std::vector<int> remap(numPoints, -1);
+    std::vector<glm::vec3> newPoints;
+    newPoints.reserve(numPoints);
+    std::vector<glm::ivec3> newTriangles;
+    newTriangles.reserve(triangles.size());
+    for (const int t : order) {
+        glm::ivec3 tri = triangles[t];
+        for (int j = 0; j < 3; j++) {
+            int &r = remap[tri[j]];
+            if (r < 0) {
+                r = newPoints.size();
+                newPoints.push_back(points[tri[j]]);
+            }
+            tri[j] = r;
+        }
+        newTriangles.push_back(tri);
+    }
+    for (int v = 0; v < numPoints; v++) {
+        if (remap[v] < 0) {
+            newPoints.push_back(points[v]);
+        }
+    }
+
+    points.swap(newPoints);
+    triangles.swap(newTriangles);
+    stats.After = MeasureVertexCache(triangles, numPoints, cacheSize);
+    return stats;
+}
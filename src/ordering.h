@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// post-transform vertex cache efficiency of an index stream, simulated with a FIFO cache
+struct CacheStats
+{
+    // average cache misses per triangle, 0.5 is ideal for large regular meshes
+    float Acmr = 0;
+    // average cache misses per vertex, 1.0 is ideal
+    float Atvr = 0;
+};
+
+struct OrderingStats
+{
+    CacheStats Before;
+    CacheStats After;
+};
+
+CacheStats MeasureVertexCache(
+    const std::vector<glm::ivec3> &triangles,
+    const int numPoints, const int cacheSize);
+
+// reorder triangles for the post-transform vertex cache (Tipsify, Sander et al. 2007)
+// and renumber points in first-use order, both in linear time
+OrderingStats OptimizeMeshOrder(
+    std::vector<glm::vec3> &points,
+    std::vector<glm::ivec3> &triangles,
+    const int cacheSize);
@@ -0,0 +1,92 @@
+#include "parallel.h"
+
+ThreadPool& ThreadPool::Shared()
+{
+    static ThreadPool pool(DefaultThreadCount() - 1);
+    return pool;
+}
+
+ThreadPool::ThreadPool(const int workers)
+{
+    m_Workers.reserve(workers);
+    for (int i = 0; i < workers; ++i)
+    {
+        m_Workers.emplace_back(&ThreadPool::Work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_Queued.notify_all();
+    for (std::thread& worker : m_Workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::Run(const int count, const std::function<void(int)>& task)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    Batch batch { &task, count - 1 };
+    if (count > 1)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (int i = 1; i < count; ++i)
+            {
+                m_Jobs.push_back({ &batch, i });
+            }
+        }
+        m_Queued.notify_all();
+    }
+
+    task(0);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (batch.Remaining > 0)
+    {
+        if (m_Jobs.empty())
+        {
+            m_Finished.wait(lock);
+            continue;
+        }
+        const Job job = m_Jobs.front();
+        m_Jobs.pop_front();
+        Execute(job, lock);
+    }
+}
+
+void ThreadPool::Work()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+        m_Queued.wait(lock, [this]() { return m_Stop || !m_Jobs.empty(); });
+        if (m_Jobs.empty())
+        {
+            return;
+        }
+        const Job job = m_Jobs.front();
+        m_Jobs.pop_front();
+        Execute(job, lock);
+    }
+}
+
+void ThreadPool::Execute(const Job& job, std::unique_lock<std::mutex>& lock)
+{
+    lock.unlock();
+    (*job.Owner->Task)(job.Index);
+    lock.lock();
+    if (--job.Owner->Remaining == 0)
+    {
+        m_Finished.notify_all();
+    }
+}
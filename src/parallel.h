@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline int DefaultThreadCount()
+{
+    const unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : static_cast<int>(n);
+}
+
+// one worker per hardware core besides the caller, started on first use and kept
+// for the life of the process, so parallel loops don't create threads of their own
+class ThreadPool
+{
+public:
+    static ThreadPool& Shared();
+
+    // call task(i) for every i in [0, count). the calling thread runs task(0) and
+    // then helps with queued tasks until all of them are done, so a task may run
+    // its own parallel loop without starving the pool
+    void Run(const int count, const std::function<void(int)>& task);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+    struct Batch
+    {
+        const std::function<void(int)>* Task;
+        int Remaining;
+    };
+
+    struct Job
+    {
+        Batch* Owner;
+        int Index;
+    };
+
+    explicit ThreadPool(const int workers);
+    ~ThreadPool();
+
+    void Work();
+
+    // runs a job popped under lock, which is released while it runs
+    void Execute(const Job& job, std::unique_lock<std::mutex>& lock);
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Queued;
+    std::condition_variable m_Finished;
+    std::deque<Job> m_Jobs;
+    std::vector<std::thread> m_Workers;
+    bool m_Stop = false;
+};
+
+// split [0, n) into one contiguous chunk per thread and call fn(begin, end)
+// on each of them, the calling thread takes the first chunk and the shared
+// pool the rest. threads <= 0 means one thread per hardware core, more
+// chunks than cores queue up behind each other
+template <class Fn>
+void ParallelFor(const int n, int threads, const Fn& fn)
+{
+    if (n <= 0)
+    {
+        return;
+    }
+    if (threads <= 0)
+    {
+        threads = DefaultThreadCount();
+    }
+    threads = std::min(threads, n);
+    if (threads == 1)
+    {
+        fn(0, n);
+        return;
+    }
+
+    const int chunk = (n + threads - 1) / threads;
+    const int chunks = (n + chunk - 1) / chunk;
+    ThreadPool::Shared().Run(chunks, [&](const int i)
+    {
+        fn(i * chunk, std::min(n, (i + 1) * chunk));
+    });
+}
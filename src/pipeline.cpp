@@ -0,0 +1,247 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "curve.h"
+#include "minmax.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+    // small enough for a chunk to stay in L2 while every op runs over it
+    constexpr int ChunkSize = 1 << 14;
+}
+
+HeightmapPipeline &HeightmapPipeline::AutoLevel() {
+    m_Ops.push_back({ OpType::AutoLevel });
+    return *this;
+}
+
+HeightmapPipeline &HeightmapPipeline::Invert() {
+    m_Ops.push_back({ OpType::Invert });
+    return *this;
+}
+
+HeightmapPipeline &HeightmapPipeline::GammaCurve(const float gamma) {
+    m_Ops.push_back({ OpType::GammaCurve, gamma });
+    return *this;
+}
+
+HeightmapPipeline &HeightmapPipeline::ToneCurve(std::function<float(float)> curve) {
+    Op op{ OpType::ToneCurve };
+    op.Curve = std::move(curve);
+    m_Ops.push_back(std::move(op));
+    return *this;
+}
+
+HeightmapPipeline &HeightmapPipeline::GaussianBlur(const int r) {
+    m_Ops.push_back({ OpType::GaussianBlur, 0, 0, r });
+    return *this;
+}
+
+HeightmapPipeline &HeightmapPipeline::AddBorder(const int size, const float z) {
+    m_Ops.push_back({ OpType::AddBorder, z, 0, size });
+    return *this;
+}
+
+void HeightmapPipeline::Transform(
+    const std::vector<Op> &ops, const int begin, const int end,
+    float *data, const int n)
+{
+    // one simple loop per op, each of which the compiler can vectorize
+    for (int k = begin; k < end; k++) {
+        const Op &op = ops[k];
+        switch (op.Type) {
+        case OpType::AutoLevel: {
+            if (op.Size == 0) {
+                break;
+            }
+            const float l = op.A;
+            const float h = op.B;
+            for (int i = 0; i < n; i++) {
+                data[i] = (data[i] - l) / (h - l);
+            }
+            break;
+        }
+        case OpType::Invert:
+            for (int i = 0; i < n; i++) {
+                data[i] = 1.f - data[i];
+            }
+            break;
+        case OpType::GammaCurve: {
+            const float gamma = op.A;
+            for (int i = 0; i < n; i++) {
+                data[i] = std::pow(data[i], gamma);
+            }
+            break;
+        }
+        case OpType::ToneCurve:
+            for (int i = 0; i < n; i++) {
+                data[i] = op.Curve(data[i]);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void HeightmapPipeline::Apply(Heightmap &hm) {
+    HMM_TRACE_SCOPE("HeightmapPipeline::Apply");
+    m_Passes = 0;
+    if (hm.Count() == 0) {
+        return;
+    }
+    hm.Invalidate();
+
+    std::vector<Op> ops = m_Ops;
+    bool known = false;
+    bool quantized = hm.m_Quantized;
+    float lo = 0;
+    float hi = 0;
+
+    // runs process(begin, size) over cache-sized chunks of the data in parallel and
+    // leaves the range of its output in lo/hi. like Heightmap::AutoLevel each
+    // chunk is reduced into its own slot, seeded from its first value, so a NaN
+    // there still wins and the result doesn't depend on the thread count
+    std::vector<float> los;
+    std::vector<float> his;
+    const auto pass = [&](const auto &process) {
+        const float *data = hm.m_Values;
+        const int n = hm.Count();
+        const int chunks = (n + ChunkSize - 1) / ChunkSize;
+        los.resize(chunks);
+        his.resize(chunks);
+        ParallelFor(chunks, m_Threads, [&](const int c0, const int c1) {
+            for (int c = c0; c < c1; c++) {
+                const int k = c * ChunkSize;
+                const int size = std::min(ChunkSize, n - k);
+                process(k, size);
+                los[c] = his[c] = data[k];
+                MinMax(data + k, size, los[c], his[c]);
+            }
+        });
+        // border pixels come first
+        lo = hm.m_Border > 0 ? hm.m_BorderZ : los[0];
+        hi = hm.m_Border > 0 ? hm.m_BorderZ : his[0];
+        for (int c = 0; c < chunks; c++) {
+            lo = std::min(lo, los[c]);
+            hi = std::max(hi, his[c]);
+        }
+        // a scalar loop keeps the first of -0 and +0, like Heightmap::AutoLevel
+        if (lo == 0 || hi == 0) {
+            const float zero = hm.m_Border > 0 && hm.m_BorderZ == 0 ?
+                hm.m_BorderZ : *std::find(data, data + n, 0.f);
+            lo = lo == 0 ? zero : lo;
+            hi = hi == 0 ? zero : hi;
+        }
+        known = true;
+        m_Passes++;
+    };
+
+    for (int i = 0; i < ops.size();) {
+        if (ops[i].Type == OpType::GaussianBlur) {
+            hm.GaussianBlur(ops[i].Size, m_Scratch);
+            m_Passes++;
+            known = false;
+            quantized = false;
+            i++;
+            continue;
+        }
+
+        // pointwise ops up to the next blur, closed by an AddBorder or by an
+        // AutoLevel that needs the range of the ops before it
+        bool active = false;
+        bool curve = false;
+        int j = i;
+        while (j < ops.size()) {
+            Op &op = ops[j];
+            if (op.Type == OpType::GaussianBlur) {
+                break;
+            }
+            if (op.Type == OpType::AutoLevel && !known) {
+                if (j > i) {
+                    break;
+                }
+                // nothing before this op to fuse the scan with
+                pass([](const int, const int) {});
+            }
+
+            switch (op.Type) {
+            case OpType::AutoLevel:
+                if (hi != lo) {
+                    op.A = lo;
+                    op.B = hi;
+                    op.Size = 1;
+                    lo = 0;
+                    hi = 1;
+                    active = true;
+                }
+                break;
+            case OpType::Invert: {
+                const float l = 1.f - hi;
+                hi = 1.f - lo;
+                lo = l;
+                active = true;
+                break;
+            }
+            case OpType::GammaCurve:
+            case OpType::ToneCurve:
+                curve = true;
+                known = false;
+                active = true;
+                break;
+            default:
+                break;
+            }
+
+            j++;
+            if (op.Type == OpType::AddBorder) {
+                break;
+            }
+        }
+        const bool border = ops[j - 1].Type == OpType::AddBorder;
+        const int end = border ? j - 1 : j;
+
+        // a table over the 16-bit codes replaces the whole run when it holds a
+        // curve, values that aren't codes fall back to the ops themselves
+        std::vector<float> table;
+        if (quantized && curve && hm.Count() > CurveTableSize) {
+            table = CurveTableInputs();
+            Transform(ops, i, end, table.data(), table.size());
+        }
+        const auto apply = [&](float *data, const int n) {
+            if (table.empty()) {
+                Transform(ops, i, end, data, n);
+                return;
+            }
+            ApplyCurveTable(table, [&](float v) {
+                Transform(ops, i, end, &v, 1);
+                return v;
+            }, data, n);
+        };
+
+        if (active) {
+            float *data = hm.Writable();
+            Transform(ops, i, end, &hm.m_BorderZ, 1);
+            pass([&](const int begin, const int size) {
+                apply(data + begin, size);
+            });
+            quantized = false;
+        }
+        if (border) {
+            // only stored as size and height, see Heightmap::AddBorder
+            const float z = ops[j - 1].A;
+            const bool widen = known && ops[j - 1].Size > 0;
+            hm.AddBorder(ops[j - 1].Size, z);
+            if (widen) {
+                lo = std::min(z, lo);
+                hi = std::max(z, hi);
+            }
+        }
+        i = j;
+    }
+    hm.m_Quantized = quantized;
+}
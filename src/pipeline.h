@@ -0,0 +1,79 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "heightmap.h"
+
+// records heightmap preprocessing ops and applies them with as few passes over the
+// data as possible. runs of pointwise ops (AutoLevel, Invert, GammaCurve) are fused
+// into one pass over cache-sized chunks, an AddBorder after them only records the
+// border, and the data is only materialized before a GaussianBlur.
+// every pass also finds the range of its output, which is tracked through the ops
+// that preserve it exactly, so AutoLevel only scans the data at the start or after a blur.
+// while the data is still the 16-bit codes it was loaded as, a run that holds a
+// curve is tabulated once per code and applied with one lookup per pixel.
+// the result is bit-identical to calling the same ops on the Heightmap in order
+class HeightmapPipeline {
+public:
+    HeightmapPipeline &AutoLevel();
+
+    HeightmapPipeline &Invert();
+
+    HeightmapPipeline &GammaCurve(const float gamma);
+
+    HeightmapPipeline &ToneCurve(std::function<float(float)> curve);
+
+    HeightmapPipeline &GaussianBlur(const int r);
+
+    HeightmapPipeline &AddBorder(const int size, const float z);
+
+    // threads used for the fused passes, <= 0 for one per core
+    void SetThreadCount(const int threads) {
+        m_Threads = threads;
+    }
+
+    // passes over the data made by the last Apply, counting scans and blurs
+    int Passes() const {
+        return m_Passes;
+    }
+
+    void Apply(Heightmap &hm);
+
+private:
+    enum class OpType {
+        AutoLevel,
+        Invert,
+        GammaCurve,
+        ToneCurve,
+        GaussianBlur,
+        AddBorder,
+    };
+
+    struct Op {
+        Op(const OpType type, const float a = 0, const float b = 0, const int size = 0) :
+            Type(type),
+            A(a),
+            B(b),
+            Size(size)
+        {}
+
+        OpType Type;
+        float A;
+        float B;
+        int Size;
+        std::function<float(float)> Curve;
+    };
+
+    // apply the pointwise ops [begin, end) to n values in place
+    static void Transform(
+        const std::vector<Op> &ops, const int begin, const int end,
+        float *data, const int n);
+
+    std::vector<Op> m_Ops;
+    int m_Threads = 0;
+    int m_Passes = 0;
+
+    // blur workspace, kept across Apply calls
+    std::vector<float> m_Scratch;
+};
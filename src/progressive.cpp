@@ -0,0 +1,242 @@
+#include "progressive.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "trace.h"
+
+namespace
+{
+    constexpr char Magic[4] = { 'H', 'M', 'P', 'M' };
+    constexpr uint32_t Version = 2;
+    constexpr size_t HeaderSize = 16;
+    constexpr size_t RecordSize = 16;
+    // bytes of a record covered by its check value
+    constexpr size_t PayloadSize = 12;
+
+    // 32-bit FNV-1a, continued from hash
+    uint32_t Fnv1a(uint32_t hash, const void* data, const size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    constexpr uint32_t Fnv1aBasis = 2166136261u;
+}
+
+bool SaveProgressiveMesh(const std::string& path, const Triangulator& tri)
+{
+    HMM_TRACE_SCOPE("SaveProgressiveMesh");
+
+    const Heightmap& hm = *tri.GetHeightmap();
+    if (hm.Width() > 65536 || hm.Height() > 65536)
+    {
+        return false;
+    }
+
+    const std::vector<glm::ivec2>& points = tri.PixelPoints();
+    const std::vector<int>& splits = tri.SplitTriangles();
+    std::vector<char> dst(HeaderSize + points.size() * RecordSize);
+
+    const uint32_t width = hm.Width();
+    const uint32_t height = hm.Height();
+    memcpy(dst.data(), Magic, 4);
+    memcpy(dst.data() + 4, &Version, 4);
+    memcpy(dst.data() + 8, &width, 4);
+    memcpy(dst.data() + 12, &height, 4);
+
+    uint32_t check = Fnv1a(Fnv1aBasis, dst.data(), HeaderSize);
+    char* record = dst.data() + HeaderSize;
+    for (int i = 0; i < points.size(); ++i, record += RecordSize)
+    {
+        const uint16_t x = points[i].x;
+        const uint16_t y = points[i].y;
+        const float z = hm.At(points[i]);
+        const int32_t split = splits[i];
+        memcpy(record, &x, 2);
+        memcpy(record + 2, &y, 2);
+        memcpy(record + 4, &z, 4);
+        memcpy(record + 8, &split, 4);
+        check = Fnv1a(check, record, PayloadSize);
+        memcpy(record + 12, &check, 4);
+    }
+
+    std::fstream file(path, std::ios::out | std::ios::binary);
+    file.write(dst.data(), dst.size());
+    file.close();
+    return !file.fail();
+}
+
+bool LoadProgressiveMesh(const std::string& path, const int maxPoints, ProgressiveDecoder& decoder)
+{
+    HMM_TRACE_SCOPE("LoadProgressiveMesh");
+
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    size_t remaining = maxPoints > 0 ?
+        HeaderSize + static_cast<size_t>(maxPoints) * RecordSize :
+        SIZE_MAX;
+    std::vector<char> buffer(1 << 16);
+    while (remaining > 0 && file)
+    {
+        file.read(buffer.data(), std::min(buffer.size(), remaining));
+        const size_t n = file.gcount();
+        if (!decoder.Append(buffer.data(), n))
+        {
+            return false;
+        }
+        remaining -= n;
+    }
+    return decoder.NumPoints() > 0;
+}
+
+bool ProgressiveDecoder::Append(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0 && !m_Failed)
+    {
+        const size_t want = m_HeaderRead ? RecordSize : HeaderSize;
+
+        // decode straight from the input unless a record straddles two calls
+        const uint8_t* unit = nullptr;
+        if (m_Partial.empty() && size >= want)
+        {
+            unit = bytes;
+            bytes += want;
+            size -= want;
+        }
+        else
+        {
+            const size_t n = std::min(size, want - m_Partial.size());
+            m_Partial.insert(m_Partial.end(), bytes, bytes + n);
+            bytes += n;
+            size -= n;
+            if (m_Partial.size() < want)
+            {
+                break;
+            }
+            unit = m_Partial.data();
+        }
+
+        m_Failed = !Decode(unit);
+        m_Partial.clear();
+    }
+    return !m_Failed;
+}
+
+bool ProgressiveDecoder::Decode(const uint8_t* unit)
+{
+    if (!m_HeaderRead)
+    {
+        uint32_t version = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        memcpy(&version, unit + 4, 4);
+        memcpy(&width, unit + 8, 4);
+        memcpy(&height, unit + 12, 4);
+        if (memcmp(unit, Magic, 4) != 0 || version != Version ||
+            width < 2 || height < 2 || width > 65536 || height > 65536)
+        {
+            return false;
+        }
+        m_Width = width;
+        m_Height = height;
+        m_Check = Fnv1a(Fnv1aBasis, unit, HeaderSize);
+        m_HeaderRead = true;
+        return true;
+    }
+
+    uint32_t check = 0;
+    memcpy(&check, unit + 12, 4);
+    if (check != Fnv1a(m_Check, unit, PayloadSize))
+    {
+        return false;
+    }
+    m_Check = check;
+
+    uint16_t x = 0;
+    uint16_t y = 0;
+    float z = 0;
+    int32_t split = 0;
+    memcpy(&x, unit, 2);
+    memcpy(&y, unit + 2, 2);
+    memcpy(&z, unit + 4, 4);
+    memcpy(&split, unit + 8, 4);
+
+    const int pn = m_Mesh.Points().size();
+    if (x >= m_Width || y >= m_Height || !std::isfinite(z))
+    {
+        return false;
+    }
+
+    // the four corners, in the order Triangulator::Initialize adds them
+    if (pn < 4)
+    {
+        const glm::ivec2 corner((pn & 1) * (m_Width - 1), (pn >> 1) * (m_Height - 1));
+        if (split != -1 || glm::ivec2(x, y) != corner)
+        {
+            return false;
+        }
+        m_Mesh.AddPoint(glm::ivec2(x, y));
+        m_Heights.push_back(z);
+        if (pn == 3)
+        {
+            m_Mesh.InitializeCorners(0, 1, 2, 3);
+        }
+        return true;
+    }
+
+    // without removals the slots come out the same as the triangulator's
+    if (split < 0 || split >= m_Mesh.TriangleIndices().size() / 3)
+    {
+        return false;
+    }
+
+    // the triangulator only inserts a point inside or on the edge of the
+    // triangle it splits, and never on one of its corners
+    const glm::ivec2 p(x, y);
+    const int* t = &m_Mesh.TriangleIndices()[split * 3];
+    const glm::ivec2 a = m_Mesh.Points()[t[0]];
+    const glm::ivec2 b = m_Mesh.Points()[t[1]];
+    const glm::ivec2 c = m_Mesh.Points()[t[2]];
+    const auto orient = [](const glm::ivec2 u, const glm::ivec2 v, const glm::ivec2 w)
+    {
+        return int64_t(v.x - u.x) * (w.y - u.y) - int64_t(v.y - u.y) * (w.x - u.x);
+    };
+    const int64_t d0 = orient(a, b, p);
+    const int64_t d1 = orient(b, c, p);
+    const int64_t d2 = orient(c, a, p);
+    const bool inside = (d0 >= 0 && d1 >= 0 && d2 >= 0) || (d0 <= 0 && d1 <= 0 && d2 <= 0);
+    if (!inside || p == a || p == b || p == c)
+    {
+        return false;
+    }
+
+    m_Mesh.AddPoint(glm::ivec2(x, y));
+    m_Heights.push_back(z);
+    m_Mesh.Insert(pn, split);
+    return true;
+}
+
+std::vector<glm::vec3> ProgressiveDecoder::Points(const float zScale) const
+{
+    const std::vector<glm::ivec2>& pixels = m_Mesh.Points();
+    std::vector<glm::vec3> points;
+    points.reserve(pixels.size());
+    for (int i = 0; i < pixels.size(); ++i)
+    {
+        points.emplace_back(pixels[i].x, pixels[i].y, m_Heights[i] * zScale);
+    }
+    return points;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "delaunay.h"
+#include "triangulator.h"
+
+// progressive mesh stream: a 16-byte header ("HMPM", version, width, height)
+// followed by one 16-byte record per point in insertion order (uint16 x, uint16 y,
+// float height, int32 split triangle slot, -1 for the corners, uint32 FNV-1a of the
+// header and the records so far without their check values). any prefix that ends on a record boundary decodes to the
+// triangulation at that point count.
+// returns false if the file couldn't be written or the heightmap is too large
+bool SaveProgressiveMesh(const std::string& path, const Triangulator& tri);
+
+// rebuilds the triangulation from a progressive mesh stream by replaying each
+// split and the collinear splits and Delaunay flips that follow it, which only
+// depend on the pixel coordinates. bytes can arrive in chunks of any size
+class ProgressiveDecoder
+{
+public:
+    // decode every complete record in data, false once the stream is found to be invalid
+    bool Append(const void* data, size_t size);
+
+    bool Failed() const
+    {
+        return m_Failed;
+    }
+
+    int Width() const
+    {
+        return m_Width;
+    }
+
+    int Height() const
+    {
+        return m_Height;
+    }
+
+    int NumPoints() const
+    {
+        return m_Mesh.Points().size();
+    }
+
+    // same points as Triangulator::Points(zScale) at this point count
+    std::vector<glm::vec3> Points(const float zScale) const;
+
+    // same triangles as Triangulator::Triangles(), in triangle slot order
+    std::vector<glm::ivec3> Triangles() const
+    {
+        return m_Mesh.Triangles();
+    }
+
+private:
+    bool Decode(const uint8_t* record);
+
+    std::vector<uint8_t> m_Partial;
+    bool m_HeaderRead = false;
+    bool m_Failed = false;
+    int m_Width = 0;
+    int m_Height = 0;
+    // running check value of the bytes decoded so far
+    uint32_t m_Check = 0;
+
+    DelaunayMesh m_Mesh;
+    std::vector<float> m_Heights;
+};
+
+// decode the first maxPoints points of a progressive mesh file (all of them if
+// maxPoints <= 0) without reading the rest. false if it couldn't be read or is invalid
+bool LoadProgressiveMesh(const std::string& path, const int maxPoints, ProgressiveDecoder& decoder);
@@ -0,0 +1,83 @@
+#include "quantized.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "trace.h"
+
+QuantizedMesh QuantizeMesh(const Triangulator &tri, const float zScale) {
+    HMM_TRACE_SCOPE("QuantizeMesh");
+
+    const std::vector<glm::ivec2> &points = tri.PixelPoints();
+    const Heightmap &hm = *tri.GetHeightmap();
+
+    QuantizedMesh mesh;
+    if (hm.Width() > 65536 || hm.Height() > 65536) {
+        return mesh;
+    }
+
+    // use the 16-bit codes directly when every height is one. the test matches
+    // how the loaders store code c, as c * (1.f / 65535.f)
+    float lo = points.empty() ? 0 : hm.At(points[0]);
+    float hi = lo;
+    const bool known = hm.Quantized();
+    bool codes = true;
+    for (const glm::ivec2 &p : points) {
+        const float z = hm.At(p);
+        lo = std::min(lo, z);
+        hi = std::max(hi, z);
+        if (!known) {
+            codes = codes && std::round(z * 65535.f) * (1.f / 65535.f) == z;
+        }
+    }
+
+    float zOffset = 0;
+    float zStep = 1.f / 65535.f;
+    if (!codes) {
+        zOffset = lo;
+        zStep = hi > lo ? (hi - lo) / 65535.f : 1.f;
+    }
+
+    mesh.Scale = glm::vec3(1, 1, zStep * zScale);
+    mesh.Offset = glm::vec3(0, 0, zOffset * zScale);
+    mesh.Vertices.reserve(points.size());
+    for (const glm::ivec2 &p : points) {
+        const float z = std::round((hm.At(p) - zOffset) / zStep);
+        mesh.Vertices.push_back({
+            uint16_t(p.x), uint16_t(p.y),
+            uint16_t(std::clamp(z, 0.f, 65535.f)) });
+    }
+
+    const std::vector<glm::ivec3> triangles = tri.Triangles();
+    mesh.Indices.reserve(triangles.size() * 3);
+    for (const glm::ivec3 &t : triangles) {
+        mesh.Indices.push_back(t.x);
+        mesh.Indices.push_back(t.y);
+        mesh.Indices.push_back(t.z);
+    }
+    return mesh;
+}
+
+void SaveQuantizedMesh(const std::string &path, const QuantizedMesh &mesh) {
+    HMM_TRACE_SCOPE("SaveQuantizedMesh");
+
+    const uint32_t numVertices = mesh.Vertices.size();
+    const uint32_t numIndices = mesh.Indices.size();
+    const uint64_t numBytes = 32 +
+        uint64_t(numVertices) * sizeof(QuantizedVertex) +
+        uint64_t(numIndices) * 4;
+    std::vector<char> dst(numBytes);
+
+    memcpy(dst.data(), &mesh.Scale, 12);
+    memcpy(dst.data() + 12, &mesh.Offset, 12);
+    memcpy(dst.data() + 24, &numVertices, 4);
+    memcpy(dst.data() + 28, &numIndices, 4);
+    memcpy(dst.data() + 32, mesh.Vertices.data(), numVertices * sizeof(QuantizedVertex));
+    memcpy(dst.data() + 32 + numVertices * sizeof(QuantizedVertex), mesh.Indices.data(), uint64_t(numIndices) * 4);
+
+    std::fstream file(path, std::ios::out | std::ios::binary);
+    file.write(dst.data(), numBytes);
+    file.close();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "triangulator.h"
+
+struct QuantizedVertex {
+    uint16_t X;
+    uint16_t Y;
+    uint16_t Z;
+};
+
+// position = Offset + Scale * (X, Y, Z)
+struct QuantizedMesh {
+    glm::vec3 Scale = glm::vec3(1);
+    glm::vec3 Offset = glm::vec3(0);
+    std::vector<QuantizedVertex> Vertices;
+    std::vector<uint32_t> Indices;
+};
+
+// 6-byte vertices for tri's points, in the same order as Points(zScale), and the
+// indices of Triangles(). x/y are the integer pixel coordinates, so they are exact.
+// heights that are all 16-bit codes (Heightmap::Quantized(), or every point's height
+// equal to c * (1.f / 65535.f) for some code c) are stored as those codes without loss. ops that move heights off the codes, such as Main's
+// default AutoLevel on a map that doesn't already span the full 16-bit range,
+// make the export lossy: the used height range is then spread over 16 bits,
+// which rounds each height to 1/65535 of that range.
+// Vertices is empty if the heightmap is wider or taller than 65536 pixels
+QuantizedMesh QuantizeMesh(const Triangulator &tri, const float zScale);
+
+// little-endian header (scale, offset, vertex and index counts) followed by the
+// packed vertices and 32-bit indices
+void SaveQuantizedMesh(const std::string &path, const QuantizedMesh &mesh);
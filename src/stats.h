@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// build with HMM_ENABLE_STATS=1 to collect hot-path counters and per-phase timings,
+// otherwise HMM_STAT and HMM_STAT_TIMER compile to nothing
+#ifndef HMM_ENABLE_STATS
+#define HMM_ENABLE_STATS 0
+#endif
+
+#if HMM_ENABLE_STATS
+#define HMM_STAT(expr) (expr)
+#define HMM_STAT_TIMER(total) const ScopedStatTimer statTimer(total)
+#else
+#define HMM_STAT(expr) ((void)0)
+#define HMM_STAT_TIMER(total) ((void)0)
+#endif
+
+// adds the lifetime of the scope to total, in nanoseconds
+class ScopedStatTimer
+{
+public:
+    explicit ScopedStatTimer(uint64_t& total) :
+        m_Total(total), m_Start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedStatTimer()
+    {
+        m_Total += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_Start).count();
+    }
+
+    ScopedStatTimer(const ScopedStatTimer&) = delete;
+    ScopedStatTimer& operator=(const ScopedStatTimer&) = delete;
+
+private:
+    uint64_t& m_Total;
+    const std::chrono::steady_clock::time_point m_Start;
+};
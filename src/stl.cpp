@@ -6,11 +6,15 @@
 #include <glm/gtx/normal.hpp>
 #include <cstring>
 
+#include "trace.h"
+
 void SaveBinarySTL(
     const std::string &path,
     const std::vector<glm::vec3> &points,
     const std::vector<glm::ivec3> &triangles)
 {
+    HMM_TRACE_SCOPE("SaveBinarySTL");
+
     // TODO: properly handle endian-ness
 
     const uint64_t numBytes = uint64_t(triangles.size()) * 50 + 84;
@@ -0,0 +1,169 @@
+#include "terrain.h"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/polar_coordinates.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+    constexpr float Pi = 3.14159265358979f;
+
+    // rows per band, small enough that a band's outputs are still in cache when
+    // the next band starts
+    constexpr int BandSize = 16;
+
+    // row y with x = -1 and x = w repeating the edge pixels, so the 3x3
+    // neighbourhood of every pixel is in range
+    void PaddedRow(const Heightmap &hm, int y, const float zScale, float *row) {
+        const int w = hm.Width();
+        y = std::min(std::max(y, 0), hm.Height() - 1);
+        hm.Row(y, row + 1);
+        for (int x = 1; x <= w; x++) {
+            row[x] *= zScale;
+        }
+        row[0] = row[1];
+        row[w + 1] = row[w];
+    }
+
+    bool SaveRaster(
+        const std::string &path, const int w, const int h,
+        const std::vector<float> &values)
+    {
+        if (values.empty()) {
+            return true;
+        }
+        // values are written as they are, little-endian on every target
+        std::ofstream header(path.substr(0, path.find_last_of('.')) + ".hdr");
+        header << "ncols " << w << "\nnrows " << h << "\nnbits 32\nbyteorder LSBFIRST\n";
+        std::ofstream file(path, std::ios::out | std::ios::binary);
+        file.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(float));
+        header.close();
+        file.close();
+        return !header.fail() && !file.fail();
+    }
+}
+
+TerrainDerivatives ComputeTerrainDerivatives(const Heightmap &hm, const TerrainOptions &options) {
+    HMM_TRACE_SCOPE("ComputeTerrainDerivatives");
+    const int w = hm.Width();
+    const int h = hm.Height();
+    const size_t n = size_t(w) * h;
+
+    TerrainDerivatives result;
+    result.Width = w;
+    result.Height = h;
+    if (options.Normals) {
+        result.Normals.resize(n);
+    }
+    if (options.Slope) {
+        result.Slope.resize(n);
+    }
+    if (options.Aspect) {
+        result.Aspect.resize(n);
+    }
+    if (options.ProfileCurvature) {
+        result.ProfileCurvature.resize(n);
+    }
+    if (options.PlanCurvature) {
+        result.PlanCurvature.resize(n);
+    }
+    std::vector<glm::vec3> lights;
+    for (const HillshadeLight &light : options.Hillshades) {
+        result.Hillshades.emplace_back(n);
+        lights.push_back(glm::euclidean(glm::vec2(
+            glm::radians(light.Altitude), glm::radians(-light.Azimuth))).xzy());
+    }
+    const bool curvature = options.ProfileCurvature || options.PlanCurvature;
+
+    const int bands = (h + BandSize - 1) / BandSize;
+    ParallelFor(bands, options.Threads, [&](const int b0, const int b1) {
+        // three padded rows, rotated as the band moves down
+        std::vector<float> buffer((w + 2) * 3);
+        float *rows[3] = { buffer.data(), buffer.data() + w + 2, buffer.data() + (w + 2) * 2 };
+        const int y0 = b0 * BandSize;
+        const int y1 = std::min(h, b1 * BandSize);
+        PaddedRow(hm, y0 - 1, options.ZScale, rows[0]);
+        PaddedRow(hm, y0, options.ZScale, rows[1]);
+        for (int y = y0; y < y1; y++) {
+            PaddedRow(hm, y + 1, options.ZScale, rows[2]);
+            const float *above = rows[0] + 1;
+            const float *row = rows[1] + 1;
+            const float *below = rows[2] + 1;
+            const size_t i0 = size_t(y) * w;
+
+            for (int x = 0; x < w; x++) {
+                const float z1 = above[x - 1];
+                const float z2 = above[x];
+                const float z3 = above[x + 1];
+                const float z4 = row[x - 1];
+                const float z5 = row[x];
+                const float z6 = row[x + 1];
+                const float z7 = below[x - 1];
+                const float z8 = below[x];
+                const float z9 = below[x + 1];
+
+                // Horn's gradient
+                const float p = ((z3 + 2 * z6 + z9) - (z1 + 2 * z4 + z7)) / 8;
+                const float q = ((z7 + 2 * z8 + z9) - (z1 + 2 * z2 + z3)) / 8;
+                const float pq = p * p + q * q;
+                const size_t i = i0 + x;
+
+                const float length = std::sqrt(pq + 1);
+                const float gradient = std::sqrt(pq);
+                const glm::vec3 normal = glm::vec3(p, q, 1) / length;
+                if (options.Normals) {
+                    result.Normals[i] = normal;
+                }
+                if (options.Slope) {
+                    result.Slope[i] = std::atan(gradient);
+                }
+                if (options.Aspect) {
+                    float aspect = -1;
+                    if (pq > 0) {
+                        aspect = std::atan2(-p, q);
+                        aspect = aspect < 0 ? aspect + 2 * Pi : aspect;
+                    }
+                    result.Aspect[i] = aspect;
+                }
+                if (curvature) {
+                    const float r = z4 - 2 * z5 + z6;
+                    const float t = z2 - 2 * z5 + z8;
+                    const float s = (z1 + z9 - z3 - z7) / 4;
+                    const bool flat = pq == 0;
+                    if (options.ProfileCurvature) {
+                        result.ProfileCurvature[i] = flat ? 0 :
+                            -(p * p * r + 2 * p * q * s + q * q * t) /
+                            (pq * (pq + 1) * length);
+                    }
+                    if (options.PlanCurvature) {
+                        result.PlanCurvature[i] = flat ? 0 :
+                            -(q * q * r - 2 * p * q * s + p * p * t) /
+                            (pq * gradient);
+                    }
+                }
+                for (size_t k = 0; k < lights.size(); k++) {
+                    result.Hillshades[k][i] = glm::clamp(glm::dot(normal, lights[k]), 0.f, 1.f) * 255;
+                }
+            }
+
+            std::rotate(rows, rows + 1, rows + 3);
+        }
+    });
+    return result;
+}
+
+bool SaveTerrainDerivatives(const std::string &prefix, const TerrainDerivatives &derivatives) {
+    HMM_TRACE_SCOPE("SaveTerrainDerivatives");
+    const int w = derivatives.Width;
+    const int h = derivatives.Height;
+    bool ok = SaveRaster(prefix + "Slope.f32", w, h, derivatives.Slope);
+    ok = SaveRaster(prefix + "Aspect.f32", w, h, derivatives.Aspect) && ok;
+    ok = SaveRaster(prefix + "ProfileCurvature.f32", w, h, derivatives.ProfileCurvature) && ok;
+    ok = SaveRaster(prefix + "PlanCurvature.f32", w, h, derivatives.PlanCurvature) && ok;
+    return ok;
+}
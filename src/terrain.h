@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "heightmap.h"
+
+struct HillshadeLight {
+    // degrees above the horizon and clockwise from north, as in SaveHillshade
+    float Altitude = 45;
+    float Azimuth = 315;
+};
+
+// which products to compute. every product is one value per pixel from the 3x3
+// neighbourhood around it, edge pixels repeat the nearest row or column
+struct TerrainOptions {
+    float ZScale = 1;
+    // unit normals oriented like Normalmap's
+    bool Normals = false;
+    // radians from horizontal
+    bool Slope = false;
+    // downhill direction in radians clockwise from north (-y), -1 where flat
+    bool Aspect = false;
+    // curvature along and across the slope direction, 0 where flat
+    bool ProfileCurvature = false;
+    bool PlanCurvature = false;
+    // one 8-bit hillshade per light
+    std::vector<HillshadeLight> Hillshades;
+    // threads working on bands of rows, <= 0 for one per core
+    int Threads = 0;
+};
+
+// the requested products, the others are left empty
+struct TerrainDerivatives {
+    int Width = 0;
+    int Height = 0;
+    std::vector<glm::vec3> Normals;
+    std::vector<float> Slope;
+    std::vector<float> Aspect;
+    std::vector<float> ProfileCurvature;
+    std::vector<float> PlanCurvature;
+    std::vector<std::vector<uint8_t>> Hillshades;
+};
+
+// computes every requested product in one pass that reads each row of heights
+// once per band. gradients use Horn's weights and curvatures the
+// Zevenbergen-Thorne second derivatives, with p, q the height slopes along x and y:
+// profile = -(p²r + 2pqs + q²t) / ((p² + q²)(1 + p² + q²)^1.5),
+// plan = -(q²r - 2pqs + p²t) / (p² + q²)^1.5
+TerrainDerivatives ComputeTerrainDerivatives(const Heightmap &hm, const TerrainOptions &options);
+
+// writes each computed scalar product as prefix + Slope, Aspect, ProfileCurvature
+// or PlanCurvature .f32, next to the .hdr header the Heightmap loader reads them
+// back with. returns false if any file couldn't be written
+bool SaveTerrainDerivatives(const std::string &prefix, const TerrainDerivatives &derivatives);
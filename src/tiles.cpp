@@ -0,0 +1,234 @@
+#include "tiles.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#include "ordering.h"
+#include "parallel.h"
+#include "trace.h"
+#include "triangulator.h"
+
+namespace {
+    struct Tile {
+        int Z;
+        int X;
+        int Y;
+        glm::ivec2 Min;
+        glm::ivec2 Max;
+    };
+
+    class Writer {
+    public:
+        explicit Writer(std::vector<uint8_t> &dst) : m_Dst(dst) {}
+
+        template <class T>
+        void Put(const T value) {
+            const size_t n = m_Dst.size();
+            m_Dst.resize(n + sizeof(T));
+            memcpy(m_Dst.data() + n, &value, sizeof(T));
+        }
+
+        void PutIndex(const uint32_t i, const bool wide) {
+            if (wide) {
+                Put(i);
+            } else {
+                Put(uint16_t(i));
+            }
+        }
+
+    private:
+        std::vector<uint8_t> &m_Dst;
+    };
+
+    uint16_t ZigZag(const int value) {
+        return uint16_t((uint32_t(value) << 1) ^ uint32_t(value >> 31));
+    }
+
+    int Quantize(const float value, const float lo, const float hi) {
+        if (hi <= lo) {
+            return 0;
+        }
+        return std::clamp(int(std::round((value - lo) / (hi - lo) * 32767.f)), 0, 32767);
+    }
+}
+
+std::vector<uint8_t> EncodeTerrainTile(
+    std::vector<glm::vec3> points,
+    std::vector<glm::ivec3> triangles,
+    const glm::ivec2 min, const glm::ivec2 max)
+{
+    // first-use order, so every index is at most one above the highest so far
+    OptimizeMeshOrder(points, triangles, 16);
+
+    float lo = points.empty() ? 0 : points[0].z;
+    float hi = lo;
+    for (const glm::vec3 &p : points) {
+        lo = std::min(lo, p.z);
+        hi = std::max(hi, p.z);
+    }
+
+    const int n = points.size();
+    std::vector<int> u(n);
+    std::vector<int> v(n);
+    std::vector<int> h(n);
+    for (int i = 0; i < n; i++) {
+        u[i] = Quantize(points[i].x, min.x, max.x);
+        v[i] = Quantize(max.y - points[i].y, 0, max.y - min.y);
+        h[i] = Quantize(points[i].z, lo, hi);
+    }
+
+    std::vector<uint8_t> dst;
+    dst.reserve(24 + 4 + n * 6 + 4 + triangles.size() * 12 + 64);
+    Writer out(dst);
+    out.Put(lo);
+    out.Put(hi);
+    out.Put(int32_t(min.x));
+    out.Put(int32_t(min.y));
+    out.Put(int32_t(max.x));
+    out.Put(int32_t(max.y));
+
+    out.Put(uint32_t(n));
+    for (const std::vector<int> *values : { &u, &v, &h }) {
+        int previous = 0;
+        for (const int value : *values) {
+            out.Put(ZigZag(value - previous));
+            previous = value;
+        }
+    }
+
+    const bool wide = n > 65536;
+    if (wide && dst.size() % 4 != 0) {
+        out.Put(uint16_t(0));
+    }
+
+    out.Put(uint32_t(triangles.size()));
+    uint32_t highest = 0;
+    for (const glm::ivec3 &t : triangles) {
+        for (const int i : { t.x, t.y, t.z }) {
+            out.PutIndex(highest - i, wide);
+            if (i == highest) {
+                highest++;
+            }
+        }
+    }
+
+    // west, south, east, north, each sorted along its edge
+    std::vector<uint32_t> edges[4];
+    for (int i = 0; i < n; i++) {
+        if (u[i] == 0) edges[0].push_back(i);
+        if (v[i] == 0) edges[1].push_back(i);
+        if (u[i] == 32767) edges[2].push_back(i);
+        if (v[i] == 32767) edges[3].push_back(i);
+    }
+    for (int e = 0; e < 4; e++) {
+        const std::vector<int> &along = e % 2 == 0 ? v : u;
+        std::sort(edges[e].begin(), edges[e].end(), [&](const uint32_t a, const uint32_t b) {
+            return along[a] < along[b];
+        });
+        out.Put(uint32_t(edges[e].size()));
+        for (const uint32_t i : edges[e]) {
+            out.PutIndex(i, wide);
+        }
+    }
+    return dst;
+}
+
+bool BuildTilePyramid(
+    const Heightmap &hm, const std::string &dir,
+    const TilePyramidOptions &options, TilePyramidStats *stats)
+{
+    HMM_TRACE_SCOPE("BuildTilePyramid");
+
+    const int w = hm.Width();
+    const int h = hm.Height();
+    if (w < 2 || h < 2) {
+        return false;
+    }
+
+    int maxZoom = std::max(options.MaxZoom, 0);
+    while (maxZoom > 0 && std::min(w, h) - 1 < (1 << maxZoom)) {
+        maxZoom--;
+    }
+
+    // coarsest (and largest) tiles first, so they don't end up last on one thread
+    std::vector<Tile> tiles;
+    for (int z = 0; z <= maxZoom; z++) {
+        const int n = 1 << z;
+        for (int x = 0; x < n; x++) {
+            std::error_code error;
+            std::filesystem::create_directories(
+                std::filesystem::path(dir) / std::to_string(z) / std::to_string(x), error);
+            if (error) {
+                return false;
+            }
+            for (int y = 0; y < n; y++) {
+                const glm::ivec2 min(int64_t(x) * (w - 1) / n, int64_t(y) * (h - 1) / n);
+                const glm::ivec2 max(int64_t(x + 1) * (w - 1) / n, int64_t(y + 1) * (h - 1) / n);
+                tiles.push_back({ z, x, y, min, max });
+            }
+        }
+    }
+
+    std::atomic<int> next(0);
+    std::atomic<bool> ok(true);
+    std::atomic<uint64_t> vertices(0);
+    std::atomic<uint64_t> triangles(0);
+    std::atomic<uint64_t> bytes(0);
+
+    const int threads = options.Threads > 0 ? options.Threads : DefaultThreadCount();
+    ParallelFor(threads, threads, [&](int, int) {
+        for (int i = next++; i < tiles.size(); i = next++) {
+            HMM_TRACE_SCOPE("BuildTile");
+            const Tile &tile = tiles[i];
+            const int tw = tile.Max.x - tile.Min.x + 1;
+            const int th = tile.Max.y - tile.Min.y + 1;
+
+            std::vector<float> data(tw * th);
+            for (int y = 0; y < th; y++) {
+                for (int x = 0; x < tw; x++) {
+                    data[y * tw + x] = hm.At(tile.Min.x + x, tile.Min.y + y);
+                }
+            }
+
+            const float error = std::ldexp(options.MaxError, maxZoom - tile.Z);
+            Triangulator tri(std::make_shared<Heightmap>(tw, th, data), error, 0, 0);
+            tri.Initialize();
+            tri.Run();
+
+            std::vector<glm::vec3> points = tri.Points(1);
+            for (glm::vec3 &p : points) {
+                p.x += tile.Min.x;
+                p.y += tile.Min.y;
+            }
+            const std::vector<glm::ivec3> tileTriangles = tri.Triangles();
+            const std::vector<uint8_t> encoded =
+                EncodeTerrainTile(points, tileTriangles, tile.Min, tile.Max);
+
+            const std::filesystem::path path = std::filesystem::path(dir) /
+                std::to_string(tile.Z) / std::to_string(tile.X) / (std::to_string(tile.Y) + ".terrain");
+            std::fstream file(path, std::ios::out | std::ios::binary);
+            file.write(reinterpret_cast<const char *>(encoded.data()), encoded.size());
+            file.close();
+            if (file.fail()) {
+                ok = false;
+            }
+
+            vertices += points.size();
+            triangles += tileTriangles.size();
+            bytes += encoded.size();
+        }
+    });
+
+    if (stats) {
+        stats->Tiles = tiles.size();
+        stats->Vertices = vertices;
+        stats->Triangles = triangles;
+        stats->Bytes = bytes;
+    }
+    return ok;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "heightmap.h"
+
+struct TilePyramidOptions {
+    // deepest level, level z has 2^z x 2^z tiles. clamped so tiles are at least 2 pixels wide
+    int MaxZoom = 4;
+    // triangulation error at MaxZoom, doubled for every level above it
+    float MaxError = 0.001f;
+    // threads building tiles, <= 0 for one per core
+    int Threads = 0;
+};
+
+struct TilePyramidStats {
+    int Tiles = 0;
+    uint64_t Vertices = 0;
+    uint64_t Triangles = 0;
+    uint64_t Bytes = 0;
+};
+
+// quantized-mesh-style tile: a 24-byte header (float min/max height, int32 x0, y0,
+// x1, y1 inclusive pixel bounds), the vertex count and zig-zag delta-encoded
+// uint16 u, v and height arrays (u/v 0..32767 across the tile with v = 0 on the
+// last row, height 0..32767 between min and max), the triangle count and
+// high-water-mark encoded indices, then the west, south, east and north edge
+// vertex lists (count + indices, sorted along the edge) for the client's skirts.
+// indices are 16-bit up to 65536 vertices, otherwise 32-bit and 4-byte aligned.
+// vertices are renumbered in first-use order, which the high-water-mark coding needs
+std::vector<uint8_t> EncodeTerrainTile(
+    std::vector<glm::vec3> points,
+    std::vector<glm::ivec3> triangles,
+    const glm::ivec2 min, const glm::ivec2 max);
+
+// triangulate every tile of every level with an error scaled to its level and
+// write it to dir/z/x/y.terrain. neighbouring tiles share their edge pixels but
+// not necessarily their edge vertices, the edge lists let clients hide the cracks
+// with skirts. returns false if a tile couldn't be written
+bool BuildTilePyramid(
+    const Heightmap &hm, const std::string &dir,
+    const TilePyramidOptions &options, TilePyramidStats *stats = nullptr);
@@ -0,0 +1,128 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct Event
+    {
+        const char* Name;
+        std::chrono::steady_clock::time_point Start;
+        std::chrono::steady_clock::time_point End;
+    };
+
+    // each thread appends to its own buffer, so recording takes no lock
+    struct ThreadBuffer
+    {
+        int Tid;
+        std::vector<Event> Events;
+    };
+
+    std::mutex g_Mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> g_Buffers;
+    std::chrono::steady_clock::time_point g_Epoch;
+
+    ThreadBuffer& LocalBuffer()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = nullptr;
+        if (!buffer)
+        {
+            std::lock_guard<std::mutex> lock(g_Mutex);
+            buffer = std::make_shared<ThreadBuffer>();
+            // lowest tid not taken, so the ids of exited threads are reused
+            int tid = 1;
+            while (std::any_of(g_Buffers.begin(), g_Buffers.end(),
+                [tid](const std::shared_ptr<ThreadBuffer>& other) { return other->Tid == tid; }))
+            {
+                tid++;
+            }
+            buffer->Tid = tid;
+            g_Buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    // forget the buffers only g_Buffers still holds, their threads have exited
+    void DropExitedThreads()
+    {
+        g_Buffers.erase(std::remove_if(g_Buffers.begin(), g_Buffers.end(),
+            [](const std::shared_ptr<ThreadBuffer>& buffer) { return buffer.use_count() == 1; }),
+            g_Buffers.end());
+    }
+
+    double Microseconds(const std::chrono::steady_clock::duration d)
+    {
+        return std::chrono::duration<double, std::micro>(d).count();
+    }
+
+    void WriteEscaped(FILE* file, const char* s)
+    {
+        for (; *s; ++s)
+        {
+            if (*s == '"' || *s == '\\')
+            {
+                fputc('\\', file);
+            }
+            fputc(*s, file);
+        }
+    }
+}
+
+void Trace::Begin()
+{
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    DropExitedThreads();
+    for (const auto& buffer : g_Buffers)
+    {
+        buffer->Events.clear();
+    }
+    g_Epoch = std::chrono::steady_clock::now();
+    g_Recording.store(true, std::memory_order_relaxed);
+}
+
+bool Trace::End(const std::string& path)
+{
+    g_Recording.store(false, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    bool first = true;
+    for (const auto& buffer : g_Buffers)
+    {
+        if (buffer->Events.empty())
+        {
+            continue;
+        }
+        fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+            first ? "" : ",", buffer->Tid, buffer->Tid);
+        first = false;
+        for (const Event& e : buffer->Events)
+        {
+            fputs(",\n{\"name\":\"", file);
+            WriteEscaped(file, e.Name);
+            fprintf(file, "\",\"cat\":\"hmm\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                buffer->Tid, Microseconds(e.Start - g_Epoch), Microseconds(e.End - e.Start));
+        }
+        buffer->Events.clear();
+    }
+    DropExitedThreads();
+    fputs("\n]}\n", file);
+    return fclose(file) == 0;
+}
+
+void Trace::Record(const char* name,
+    const std::chrono::steady_clock::time_point start,
+    const std::chrono::steady_clock::time_point end)
+{
+    LocalBuffer().Events.push_back({ name, start, end });
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// build with HMM_ENABLE_TRACE=0 to strip every trace scope. when compiled in but
+// not recording, a scope costs a single relaxed atomic load
+#ifndef HMM_ENABLE_TRACE
+#define HMM_ENABLE_TRACE 1
+#endif
+
+#define HMM_TRACE_CONCAT_(a, b) a##b
+#define HMM_TRACE_CONCAT(a, b) HMM_TRACE_CONCAT_(a, b)
+
+#if HMM_ENABLE_TRACE
+// name must be a string literal, or otherwise outlive the recording
+#define HMM_TRACE_SCOPE(name) const TraceScope HMM_TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define HMM_TRACE_SCOPE(name) ((void)0)
+#endif
+
+// records nested scopes from any thread and writes them as Chrome trace-event
+// JSON, which loads in chrome://tracing and ui.perfetto.dev
+namespace Trace
+{
+    // discard previously recorded events and start recording.
+    // call while no traced work is running
+    void Begin();
+
+    // stop recording and write the events to path, false if the file couldn't be written
+    bool End(const std::string& path);
+
+    inline std::atomic<bool> g_Recording { false };
+
+    inline bool IsRecording()
+    {
+        return g_Recording.load(std::memory_order_relaxed);
+    }
+
+    void Record(const char* name,
+        std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end);
+}
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) : m_Name(Trace::IsRecording() ? name : nullptr)
+    {
+        if (m_Name)
+        {
+            m_Start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (m_Name)
+        {
+            Trace::Record(m_Name, m_Start, std::chrono::steady_clock::now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_Name;
+    std::chrono::steady_clock::time_point m_Start;
+};
@@ -1,6 +1,64 @@
 #include "triangulator.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+
+#include "parallel.h"
+#include "trace.h"
+
+namespace
+{
+    // below this many bounding box pixels a flush isn't worth waking up threads for
+    constexpr int64_t ParallelFlushPixels = 1 << 16;
+
+    uint64_t NextRevision()
+    {
+        static std::atomic<uint64_t> revision { 0 };
+        return ++revision;
+    }
+
+    // triangles of a row-major gw x gh grid, the most recently used sizes are kept
+    std::shared_ptr<const std::vector<glm::ivec3>> GridTopology(const int gw, const int gh)
+    {
+        using Topology = std::shared_ptr<const std::vector<glm::ivec3>>;
+        constexpr int CacheSize = 8;
+        static std::mutex mutex;
+        static std::vector<std::pair<glm::ivec2, Topology>> cache;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto it = std::find_if(cache.begin(), cache.end(),
+            [gw, gh](const auto& entry) { return entry.first == glm::ivec2(gw, gh); });
+        if (it != cache.end())
+        {
+            std::rotate(cache.begin(), it, it + 1);
+            return cache.front().second;
+        }
+
+        auto triangles = std::make_shared<std::vector<glm::ivec3>>();
+        triangles->reserve((gw - 1) * (gh - 1) * 2);
+        for (int j = 0; j < gh - 1; ++j)
+        {
+            for (int i = 0; i < gw - 1; ++i)
+            {
+                const int p0 = j * gw + i;
+                const int p1 = p0 + gw;
+                const int p2 = p0 + 1;
+                const int p3 = p1 + 1;
+                triangles->emplace_back(p0, p3, p2);
+                triangles->emplace_back(p0, p1, p3);
+            }
+        }
+
+        if (cache.size() == CacheSize)
+        {
+            cache.pop_back();
+        }
+        cache.emplace(cache.begin(), glm::ivec2(gw, gh), triangles);
+        return triangles;
+    }
+}
 
 Triangulator::Triangulator(
     const std::shared_ptr<Heightmap>& heightmap,
@@ -46,7 +104,10 @@ void Triangulator::Snapshot()
     m_QueueIndexesTmp = m_QueueIndexes;
     m_QueueTmp = m_Queue;
     m_PendingTmp = m_Pending;
+    m_HullEdgeTmp = m_HullEdge;
     m_MorphTargetTmp = m_MorphTarget;
+    m_SplitTrianglesTmp = m_SplitTriangles;
+    m_InsertionErrorsTmp = m_InsertionErrors;
 }
 
 void Triangulator::ReverseStep()
@@ -59,11 +120,17 @@ void Triangulator::ReverseStep()
     m_QueueIndexes = m_QueueIndexesTmp;
     m_Queue = m_QueueTmp;
     m_Pending = m_PendingTmp;
+    m_HullEdge = m_HullEdgeTmp;
     m_MorphTarget = m_MorphTargetTmp;
+    m_SplitTriangles = m_SplitTrianglesTmp;
+    m_InsertionErrors = m_InsertionErrorsTmp;
+    m_Revision = NextRevision();
+    ClearChangedTriangles();
 }
 
 void Triangulator::Run()
 {
+    HMM_TRACE_SCOPE("Triangulator::Run");
     Snapshot();
 
     // helper function to check if triangulation is complete
@@ -91,14 +158,100 @@ void Triangulator::Run()
     }
 }
 
-void Triangulator::Morph(float target)
+int Triangulator::Morph(float target)
 {
-    const int start = static_cast<float>(m_Points.size()) * target;
-    for (int i = start; i < m_Points.size(); ++i)
+    const int n = m_Points.size();
+    const float window = std::max(1.f, m_MorphWindow * n);
+    // point i is fully collapsed at cutoff <= i and fully present at cutoff >= i + window
+    const float cutoff = target * (n + window);
+
+    // parents are always inserted before their children, so their morphed
+    // position is final by the time a child reads it
+    const auto update = [this, window, cutoff](const int i)
+    {
+        const glm::vec3 point(m_Points[i], m_Heightmap->At(m_Points[i]));
+        const int parent = m_MorphTarget[i];
+        if (parent < 0)
+        {
+            m_MorphPoints[i] = point;
+            return;
+        }
+        const float blend = (cutoff - i) / window;
+        if (blend >= 1)
+        {
+            m_MorphPoints[i] = point;
+        }
+        else if (blend <= 0)
+        {
+            m_MorphPoints[i] = m_MorphPoints[parent];
+        }
+        else
+        {
+            m_MorphPoints[i] = glm::mix(m_MorphPoints[parent], point, blend);
+        }
+    };
+
+    if (m_MorphPoints.size() != n || m_MorphWindowPoints != window)
+    {
+        m_MorphPoints.resize(n);
+        m_MorphChild.assign(n, -1);
+        m_MorphSibling.assign(n, -1);
+        for (int i = n - 1; i >= 0; --i)
+        {
+            const int parent = m_MorphTarget[i];
+            if (parent >= 0)
+            {
+                m_MorphSibling[i] = m_MorphChild[parent];
+                m_MorphChild[parent] = i;
+            }
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            update(i);
+        }
+        m_MorphCutoff = cutoff;
+        m_MorphWindowPoints = window;
+        return n;
+    }
+
+    // only points within a window of either cutoff changed their blend
+    const int begin = std::max(0, static_cast<int>(std::floor(std::min(m_MorphCutoff, cutoff) - window)));
+    const int end = std::min(n, static_cast<int>(std::ceil(std::max(m_MorphCutoff, cutoff))) + 1);
+    m_MorphCutoff = cutoff;
+    if (begin >= end)
+    {
+        return 0;
+    }
+
+    for (int i = begin; i < end; ++i)
+    {
+        update(i);
+    }
+
+    // everything past the range is fully collapsed and follows its parent
+    for (int i = begin; i < end; ++i)
     {
-        if (m_MorphTarget[i] < 0) continue;
-        m_Points[i] = m_Points[m_MorphTarget[i]];
+        for (int c = m_MorphChild[i]; c >= 0; c = m_MorphSibling[c])
+        {
+            if (c >= end)
+            {
+                m_MorphStack.push_back(c);
+            }
+        }
+    }
+    int count = end - begin;
+    while (!m_MorphStack.empty())
+    {
+        const int i = m_MorphStack.back();
+        m_MorphStack.pop_back();
+        m_MorphPoints[i] = m_MorphPoints[m_MorphTarget[i]];
+        count++;
+        for (int c = m_MorphChild[i]; c >= 0; c = m_MorphSibling[c])
+        {
+            m_MorphStack.push_back(c);
+        }
     }
+    return count;
 }
 
 void Triangulator::Initialize()
@@ -111,7 +264,14 @@ void Triangulator::Initialize()
     m_QueueIndexes.clear();
     m_Queue.clear();
     m_Pending.clear();
+    m_HullEdge = -1;
     m_MorphTarget.clear();
+    m_SplitTriangles.clear();
+    m_InsertionErrors.clear();
+    m_MorphPoints.clear();
+    m_Revision = NextRevision();
+    ClearChangedTriangles();
+    m_Stats = TriangulatorStats();
 
     // add points at all four corners
     const int x0 = 0;
@@ -128,6 +288,8 @@ void Triangulator::Initialize()
     m_MorphTarget[1] = -1;
     m_MorphTarget[2] = -1;
     m_MorphTarget[3] = -1;
+    m_SplitTriangles.assign(4, -1);
+    m_InsertionErrors.assign(4, 0);
 
     // add initial two triangles
     const int t0 = AddTriangle(p3, p0, p2, -1, -1, -1, -1);
@@ -140,6 +302,66 @@ float Triangulator::Error() const
     return m_Errors[m_Queue[0]];
 }
 
+void Triangulator::ClearChangedTriangles()
+{
+    for (const int t : m_Changed)
+    {
+        if (t < m_ChangedFlags.size())
+        {
+            m_ChangedFlags[t] = 0;
+        }
+    }
+    m_Changed.clear();
+}
+
+std::vector<int> Triangulator::Hull() const
+{
+    const auto next = [](const int e) { return e - e % 3 + (e + 1) % 3; };
+
+    std::vector<int> hull;
+    if (m_HullEdge < 0)
+    {
+        return hull;
+    }
+
+    // the hull edge after e starts where e ends, rotate around that point
+    // until the next halfedge without an opposite
+    const int e0 = m_HullEdge;
+    int e = e0;
+    do
+    {
+        hull.push_back(m_Triangles[e]);
+        e = next(e);
+        while (m_Halfedges[e] >= 0)
+        {
+            e = next(m_Halfedges[e]);
+        }
+    }
+    while (e != e0);
+    return hull;
+}
+
+uint64_t Triangulator::Checksum() const
+{
+    const auto fnv1a = [](const void* data, const size_t size, uint64_t hash)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    };
+
+    const std::vector<glm::vec3> points = Points(1.f);
+    const std::vector<glm::ivec3> triangles = Triangles();
+    uint64_t hash = 14695981039346656037ull;
+    hash = fnv1a(points.data(), points.size() * sizeof(glm::vec3), hash);
+    hash = fnv1a(triangles.data(), triangles.size() * sizeof(glm::ivec3), hash);
+    return hash;
+}
+
 std::vector<glm::vec3> Triangulator::Points(const float zScale) const
 {
     std::vector<glm::vec3> points;
@@ -151,41 +373,50 @@ std::vector<glm::vec3> Triangulator::Points(const float zScale) const
     return points;
 }
 
-std::pair<std::vector<glm::vec3>, std::vector<glm::ivec3>> Triangulator::MeshGrid(const float zScale) const
+std::vector<glm::vec3> Triangulator::MorphPoints(const float zScale) const
+{
+    if (m_MorphPoints.size() != m_Points.size())
+    {
+        return Points(zScale);
+    }
+    std::vector<glm::vec3> points;
+    points.reserve(m_MorphPoints.size());
+    for (const glm::vec3& p : m_MorphPoints)
+    {
+        points.emplace_back(p.x, p.y, p.z * zScale);
+    }
+    return points;
+}
+
+GridMesh Triangulator::MeshGrid(const float zScale, const bool bilinear) const
 {
+    HMM_TRACE_SCOPE("Triangulator::MeshGrid");
+
     const int triangleCount = NumTriangles();
     const float wDivH = static_cast<float>(m_Heightmap->Width()) / m_Heightmap->Height();
     const int gh = std::sqrt(triangleCount / (2 * wDivH)) + 1;
     const int gw = static_cast<int>(gh * wDivH) + 1;
-    std::vector<glm::vec3> points;
-    points.reserve(gw * gh);
-    for (int i = 0; i < gw; ++i)
-    {
-        for (int j = 0; j < gh; ++j)
-        {
-            const float x = static_cast<float>(i) / (gw - 1) * (m_Heightmap->Width() - 1);
-            const float y = static_cast<float>(j) / (gh - 1) * (m_Heightmap->Height() - 1);
-            const float z = m_Heightmap->At(x, y) * zScale;
-            points.emplace_back(x, y, z);
-        }
-    }
 
-    std::vector<glm::ivec3> triangles;
-    triangles.reserve((gw - 1) * (gh - 1) * 2);
-    for (int i = 0; i < gw - 1; ++i)
+    GridMesh grid;
+    grid.Points.resize(gw * gh);
+    ParallelFor(gh, m_Threads, [&](const int begin, const int end)
     {
-        for (int j = 0; j < gh - 1; ++j)
+        for (int j = begin; j < end; ++j)
         {
-            const int p0 = i * gh + j;
-            const int p1 = p0 + 1;
-            const int p2 = (i + 1) * gh + j;
-            const int p3 = p2 + 1;
-            triangles.emplace_back(p0, p3, p2);
-            triangles.emplace_back(p0, p1, p3);
+            const float y = static_cast<float>(j) / (gh - 1) * (m_Heightmap->Height() - 1);
+            glm::vec3* row = &grid.Points[j * gw];
+            for (int i = 0; i < gw; ++i)
+            {
+                const float x = static_cast<float>(i) / (gw - 1) * (m_Heightmap->Width() - 1);
+                const float z = bilinear ?
+                    m_Heightmap->Sample(x, y) :
+                    m_Heightmap->At(static_cast<int>(x), static_cast<int>(y));
+                row[i] = glm::vec3(x, y, z * zScale);
+            }
         }
-    }
-
-    return { std::move(points), std::move(triangles) };
+    });
+    grid.Triangles = GridTopology(gw, gh);
+    return grid;
 }
 
 std::vector<glm::ivec3> Triangulator::Triangles() const
@@ -204,16 +435,80 @@ std::vector<glm::ivec3> Triangulator::Triangles() const
 
 void Triangulator::Flush()
 {
+    HMM_TRACE_SCOPE("Triangulator::Flush");
+    HMM_STAT_TIMER(m_Stats.FlushNs);
+
+    // every halfedge is linked by now, so -1 means the hull. the hull edge only
+    // moves when its triangle is rewritten, and then into one written since the
+    // last flush
+    if (m_HullEdge < 0 || m_Halfedges[m_HullEdge] >= 0)
+    {
+        m_HullEdge = -1;
+        for (const int t : m_Pending)
+        {
+            for (int e = t * 3; e < t * 3 + 3 && m_HullEdge < 0; ++e)
+            {
+                if (m_Halfedges[e] < 0)
+                {
+                    m_HullEdge = e;
+                }
+            }
+        }
+    }
+
+    // threads count into their own total and add it once per chunk
+    [[maybe_unused]] std::atomic<uint64_t> rasterized{0};
+    const auto rasterize = [&](const int begin, const int end)
+    {
+        HMM_TRACE_SCOPE("Triangulator::Rasterize");
+        [[maybe_unused]] uint64_t pixels = 0;
+        for (int i = begin; i < end; ++i)
+        {
+            const int t = m_Pending[i];
+            // rasterize triangle to find maximum pixel error
+            const auto pair = m_Heightmap->FindCandidate(
+                m_Points[m_Triangles[t * 3 + 0]],
+                m_Points[m_Triangles[t * 3 + 1]],
+                m_Points[m_Triangles[t * 3 + 2]],
+                &pixels);
+            // update metadata
+            m_Candidates[t] = pair.first;
+            m_Errors[t] = pair.second;
+        }
+        HMM_STAT(rasterized += pixels);
+    };
+
+    const int n = m_Pending.size();
+    int64_t pixels = 0;
+    if (m_Threads != 1 && n > 1)
+    {
+        for (const int t : m_Pending)
+        {
+            const glm::ivec2 a = m_Points[m_Triangles[t * 3 + 0]];
+            const glm::ivec2 b = m_Points[m_Triangles[t * 3 + 1]];
+            const glm::ivec2 c = m_Points[m_Triangles[t * 3 + 2]];
+            const glm::ivec2 size = glm::max(glm::max(a, b), c) - glm::min(glm::min(a, b), c) + 1;
+            pixels += int64_t(size.x) * size.y;
+        }
+    }
+
+    // each pending triangle only writes its own slot, so the rasterization can be
+    // split freely. results are merged into the queue in pending order regardless
+    // of which thread produced them
+    if (pixels >= ParallelFlushPixels)
+    {
+        HMM_STAT(m_Stats.ParallelFlushes++);
+        ParallelFor(n, m_Threads, rasterize);
+    }
+    else
+    {
+        rasterize(0, n);
+    }
+    HMM_STAT(m_Stats.FindCandidateCalls += n);
+    HMM_STAT(m_Stats.PixelsRasterized += rasterized);
+
     for (const int t : m_Pending)
     {
-        // rasterize triangle to find maximum pixel error
-        const auto pair = m_Heightmap->FindCandidate(
-            m_Points[m_Triangles[t * 3 + 0]],
-            m_Points[m_Triangles[t * 3 + 1]],
-            m_Points[m_Triangles[t * 3 + 2]]);
-        // update metadata
-        m_Candidates[t] = pair.first;
-        m_Errors[t] = pair.second;
         // add triangle to priority queue
         QueuePush(t);
     }
@@ -223,16 +518,15 @@ void Triangulator::Flush()
 
 void Triangulator::Step()
 {
+    HMM_STAT_TIMER(m_Stats.StepNs);
+    HMM_STAT(m_Stats.Steps++);
+
     // pop triangle with highest error from priority queue
     const int t = QueuePop();
 
-    const int e0 = t * 3 + 0;
-    const int e1 = t * 3 + 1;
-    const int e2 = t * 3 + 2;
-
-    const int p0 = m_Triangles[e0];
-    const int p1 = m_Triangles[e1];
-    const int p2 = m_Triangles[e2];
+    const int p0 = m_Triangles[t * 3 + 0];
+    const int p1 = m_Triangles[t * 3 + 1];
+    const int p2 = m_Triangles[t * 3 + 2];
 
     const glm::ivec2 a = m_Points[p0];
     const glm::ivec2 b = m_Points[p1];
@@ -241,55 +535,6 @@ void Triangulator::Step()
 
     const int pn = AddPoint(p);
 
-    const auto collinear = [](
-        const glm::ivec2 p0, const glm::ivec2 p1, const glm::ivec2 p2)
-    {
-        return (p1.y - p0.y) * (p2.x - p1.x) == (p2.y - p1.y) * (p1.x - p0.x);
-    };
-
-    const auto handleCollinear = [this](const int pn, const int a)
-    {
-        const int a0 = a - a % 3;
-        const int al = a0 + (a + 1) % 3;
-        const int ar = a0 + (a + 2) % 3;
-        const int p0 = m_Triangles[ar];
-        const int pr = m_Triangles[a];
-        const int pl = m_Triangles[al];
-        const int hal = m_Halfedges[al];
-        const int har = m_Halfedges[ar];
-
-        const int b = m_Halfedges[a];
-
-        if (b < 0)
-        {
-            const int t0 = AddTriangle(pn, p0, pr, -1, har, -1, a0);
-            const int t1 = AddTriangle(p0, pn, pl, t0, -1, hal, -1);
-            Legalize(t0 + 1);
-            Legalize(t1 + 2);
-            return;
-        }
-
-        const int b0 = b - b % 3;
-        const int bl = b0 + (b + 2) % 3;
-        const int br = b0 + (b + 1) % 3;
-        const int p1 = m_Triangles[bl];
-        const int hbl = m_Halfedges[bl];
-        const int hbr = m_Halfedges[br];
-
-        QueueRemove(b / 3);
-
-        const int t0 = AddTriangle(p0, pr, pn, har, -1, -1, a0);
-        const int t1 = AddTriangle(pr, p1, pn, hbr, -1, t0 + 1, b0);
-        const int t2 = AddTriangle(p1, pl, pn, hbl, -1, t1 + 1, -1);
-        const int t3 = AddTriangle(pl, p0, pn, hal, t0 + 2, t2 + 1, -1);
-
-        Legalize(t0);
-        Legalize(t1);
-        Legalize(t2);
-        Legalize(t3);
-    };
-
-
     auto iDot = [](glm::ivec2 v) { return v.x * v.x + v.y * v.y; };
     int minDis = iDot(p - a);
     int target = p0;
@@ -304,32 +549,13 @@ void Triangulator::Step()
         minDis = pcSqr;
     }
     m_MorphTarget.emplace_back(target);
+    m_SplitTriangles.push_back(t);
+    m_InsertionErrors.push_back(m_Errors[t]);
 
-    if (collinear(a, b, p))
-    {
-        handleCollinear(pn, e0);
-    }
-    else if (collinear(b, c, p))
-    {
-        handleCollinear(pn, e1);
-    }
-    else if (collinear(c, a, p))
-    {
-        handleCollinear(pn, e2);
-    }
-    else
     {
-        const int h0 = m_Halfedges[e0];
-        const int h1 = m_Halfedges[e1];
-        const int h2 = m_Halfedges[e2];
-
-        const int t0 = AddTriangle(p0, p1, pn, h0, -1, -1, e0);
-        const int t1 = AddTriangle(p1, p2, pn, h1, -1, t0 + 1, -1);
-        const int t2 = AddTriangle(p2, p0, pn, h2, t0 + 2, t1 + 1, -1);
-
-        Legalize(t0);
-        Legalize(t1);
-        Legalize(t2);
+        // insert the point and restore the Delaunay condition
+        HMM_STAT_TIMER(m_Stats.LegalizeNs);
+        Insert(pn, t);
     }
 
     Flush();
@@ -394,85 +620,44 @@ int Triangulator::AddTriangle(
     const int t = e / 3;
     m_Pending.push_back(t);
 
+    if (m_TrackChanges)
+    {
+        if (t >= m_ChangedFlags.size())
+        {
+            m_ChangedFlags.resize(t + 1, 0);
+        }
+        if (!m_ChangedFlags[t])
+        {
+            m_ChangedFlags[t] = 1;
+            m_Changed.push_back(t);
+        }
+    }
+
     // return first halfedge index
     return e;
 }
 
-void Triangulator::Legalize(const int a)
+void Triangulator::BeforeCollinearSplit(const int t)
 {
-    // if the pair of triangles doesn't satisfy the Delaunay condition
-    // (p1 is inside the circumcircle of [p0, pl, pr]), flip them,
-    // then do the same check/flip recursively for the new pair of triangles
-    //
-    //           pl                    pl
-    //          /||\                  /  \
-    //       al/ || \bl            al/    \a
-    //        /  ||  \              /      \
-    //       /  a||b  \    flip    /___ar___\
-    //     p0\   ||   /p1   =>   p0\---bl---/p1
-    //        \  ||  /              \      /
-    //       ar\ || /br             b\    /br
-    //          \||/                  \  /
-    //           pr                    pr
-
-    const auto inCircle = [](
-        const glm::ivec2 a, const glm::ivec2 b, const glm::ivec2 c,
-        const glm::ivec2 p)
-    {
-        const int64_t dx = a.x - p.x;
-        const int64_t dy = a.y - p.y;
-        const int64_t ex = b.x - p.x;
-        const int64_t ey = b.y - p.y;
-        const int64_t fx = c.x - p.x;
-        const int64_t fy = c.y - p.y;
-        const int64_t ap = dx * dx + dy * dy;
-        const int64_t bp = ex * ex + ey * ey;
-        const int64_t cp = fx * fx + fy * fy;
-        return dx * (ey * cp - bp * fy) - dy * (ex * cp - bp * fx) + ap * (ex * fy - ey * fx) < 0;
-    };
-
-    const int b = m_Halfedges[a];
-
-    if (b < 0)
+    HMM_STAT(m_Stats.CollinearSplits++);
+    if (t >= 0)
     {
-        return;
+        QueueRemove(t);
     }
+}
 
-    const int a0 = a - a % 3;
-    const int b0 = b - b % 3;
-    const int al = a0 + (a + 1) % 3;
-    const int ar = a0 + (a + 2) % 3;
-    const int bl = b0 + (b + 2) % 3;
-    const int br = b0 + (b + 1) % 3;
-    const int p0 = m_Triangles[ar];
-    const int pr = m_Triangles[a];
-    const int pl = m_Triangles[al];
-    const int p1 = m_Triangles[bl];
-
-    if (!inCircle(m_Points[p0], m_Points[pr], m_Points[pl], m_Points[p1]))
-    {
-        return;
-    }
-
-    const int hal = m_Halfedges[al];
-    const int har = m_Halfedges[ar];
-    const int hbl = m_Halfedges[bl];
-    const int hbr = m_Halfedges[br];
-
-    QueueRemove(a / 3);
-    QueueRemove(b / 3);
-
-    const int t0 = AddTriangle(p0, p1, pl, -1, hbl, hal, a0);
-    const int t1 = AddTriangle(p1, p0, pr, t0, har, hbr, b0);
-
-    Legalize(t0 + 1);
-    Legalize(t1 + 2);
+void Triangulator::BeforeFlip(const int t0, const int t1)
+{
+    HMM_STAT(m_Stats.Flips++);
+    QueueRemove(t0);
+    QueueRemove(t1);
 }
 
 // priority queue functions
 
 void Triangulator::QueuePush(const int t)
 {
+    HMM_STAT(m_Stats.HeapPushes++);
     const int i = m_Queue.size();
     m_QueueIndexes[t] = i;
     m_Queue.push_back(t);
@@ -481,6 +666,7 @@ void Triangulator::QueuePush(const int t)
 
 int Triangulator::QueuePop()
 {
+    HMM_STAT(m_Stats.HeapPops++);
     const int n = m_Queue.size() - 1;
     QueueSwap(0, n);
     QueueDown(0, n);
@@ -512,6 +698,7 @@ void Triangulator::QueueRemove(const int t)
         }
         return;
     }
+    HMM_STAT(m_Stats.HeapRemoves++);
     const int n = m_Queue.size() - 1;
     if (n != i)
     {
@@ -526,7 +713,13 @@ void Triangulator::QueueRemove(const int t)
 
 bool Triangulator::QueueLess(const int i, const int j) const
 {
-    return -m_Errors[m_Queue[i]] < -m_Errors[m_Queue[j]];
+    const int ti = m_Queue[i];
+    const int tj = m_Queue[j];
+    if (m_Deterministic && m_Errors[ti] == m_Errors[tj])
+    {
+        return ti < tj;
+    }
+    return -m_Errors[ti] < -m_Errors[tj];
 }
 
 void Triangulator::QueueSwap(const int i, const int j)
@@ -579,3 +772,28 @@ bool Triangulator::QueueDown(const int i0, const int n)
     }
     return i > i0;
 }
+
+bool VerifyDeterminism(
+    const std::shared_ptr<Heightmap>& heightmap,
+    float error, int nTri, int nVert, int maxThreads)
+{
+    uint64_t expected = 0;
+    for (int threads = 1; threads <= maxThreads; ++threads)
+    {
+        Triangulator tri(heightmap, error, nTri, nVert);
+        tri.SetThreadCount(threads);
+        tri.SetDeterministic(true);
+        tri.Initialize();
+        tri.Run();
+        const uint64_t checksum = tri.Checksum();
+        if (threads == 1)
+        {
+            expected = checksum;
+        }
+        else if (checksum != expected)
+        {
+            return false;
+        }
+    }
+    return true;
+}
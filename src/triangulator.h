@@ -5,8 +5,37 @@
 #include <vector>
 
 #include "heightmap.h"
+#include "insertion.h"
+#include "stats.h"
 
-class Triangulator
+// hot-path counters and cumulative phase timings, collected when built with HMM_ENABLE_STATS
+struct TriangulatorStats
+{
+    uint64_t Steps = 0;
+    uint64_t Flips = 0;
+    uint64_t CollinearSplits = 0;
+    uint64_t HeapPushes = 0;
+    uint64_t HeapPops = 0;
+    uint64_t HeapRemoves = 0;
+    uint64_t FindCandidateCalls = 0;
+    uint64_t PixelsRasterized = 0;
+    // flushes big enough to rasterize on the thread pool
+    uint64_t ParallelFlushes = 0;
+
+    uint64_t StepNs = 0;
+    uint64_t FlushNs = 0;
+    // point insertion and Delaunay legalization inside Step
+    uint64_t LegalizeNs = 0;
+};
+
+struct GridMesh
+{
+    std::vector<glm::vec3> Points;
+    // depends only on the grid size, so it is shared by every grid of that size
+    std::shared_ptr<const std::vector<glm::ivec3>> Triangles;
+};
+
+class Triangulator : private DelaunayInsertion<Triangulator>
 {
 public:
     Triangulator(
@@ -17,7 +46,18 @@ public:
     void RunStep();
     void ReverseStep();
     void Run();
-    void Morph(float target);
+
+    // geomorph towards the first target * NumPoints() points, blending later points
+    // into the point they were split from. writes MorphPoints() and leaves the
+    // triangulation untouched, only points whose blend changed since the last call
+    // (and their collapsed descendants) are updated. returns the number of points written
+    int Morph(float target);
+
+    // fraction of the points over which the blend ramps from 0 to 1
+    void SetMorphWindow(const float window)
+    {
+        m_MorphWindow = window;
+    }
 
     int NumPoints() const
     {
@@ -31,13 +71,111 @@ public:
 
     float Error() const;
 
+    // number of threads used to rasterize pending triangles, <= 0 for one per core
+    void SetThreadCount(const int threads)
+    {
+        m_Threads = threads;
+    }
+
+    // break ties between equal errors by triangle index, so the refinement order
+    // doesn't depend on heap layout, thread count or the order pending results arrive in
+    void SetDeterministic(const bool deterministic)
+    {
+        m_Deterministic = deterministic;
+    }
+
+    // integer pixel coordinates of every point, in insertion order
+    const std::vector<glm::ivec2>& PixelPoints() const
+    {
+        return m_Points;
+    }
+
+    // point indices of every triangle slot, triangle t is [3t, 3t + 2].
+    // slots are reused in place, so a slot's triangle can change but its index stays valid
+    const std::vector<int>& TriangleIndices() const
+    {
+        return m_Triangles;
+    }
+
+    // triangle slot each point was inserted into, -1 for the four corners.
+    // with the points this is enough to replay the triangulation, since the
+    // collinear splits and Delaunay flips only depend on the pixel coordinates
+    const std::vector<int>& SplitTriangles() const
+    {
+        return m_SplitTriangles;
+    }
+
+    // nearest corner of the triangle each point was inserted into, -1 for the four corners
+    const std::vector<int>& MorphTargets() const
+    {
+        return m_MorphTarget;
+    }
+
+    // error of the triangle each point was inserted into, 0 for the four corners
+    const std::vector<float>& InsertionErrors() const
+    {
+        return m_InsertionErrors;
+    }
+
+    // opposite halfedge of every halfedge in TriangleIndices(), -1 on the hull
+    const std::vector<int>& Halfedges() const
+    {
+        return m_Halfedges;
+    }
+
+    // point indices around the boundary in walk order, found through the halfedges
+    // that have no opposite, starting from a hull edge kept up to date by Flush. O(boundary)
+    std::vector<int> Hull() const;
+
+    const std::shared_ptr<Heightmap>& GetHeightmap() const
+    {
+        return m_Heightmap;
+    }
+
+    // changes whenever points or triangles are discarded rather than appended or
+    // rewritten (Initialize, ReverseStep), unique across all triangulators
+    uint64_t Revision() const
+    {
+        return m_Revision;
+    }
+
+    // record the triangle slots written by each step until ClearChangedTriangles()
+    void TrackChanges(const bool track)
+    {
+        m_TrackChanges = track;
+    }
+
+    // slots written since the last clear, each listed once
+    const std::vector<int>& ChangedTriangles() const
+    {
+        return m_Changed;
+    }
+
+    void ClearChangedTriangles();
+
+    // FNV-1a hash of Points(1) and Triangles(), for comparing runs
+    uint64_t Checksum() const;
+
+    // all zero unless built with HMM_ENABLE_STATS, reset by Initialize()
+    const TriangulatorStats& Stats() const
+    {
+        return m_Stats;
+    }
+
     std::vector<glm::vec3> Points(const float zScale) const;
 
+    // points as of the last Morph(), or Points() if the triangulation changed since
+    std::vector<glm::vec3> MorphPoints(const float zScale) const;
+
     std::vector<glm::ivec3> Triangles() const;
 
-    std::pair<std::vector<glm::vec3>, std::vector<glm::ivec3>> MeshGrid(const float zScale) const;
+    // regular grid with about as many triangles as the triangulation, for comparison.
+    // points are row-major, sampled bilinearly or from the nearest lower pixel
+    GridMesh MeshGrid(const float zScale, const bool bilinear) const;
 
 private:
+    friend class DelaunayInsertion<Triangulator>;
+
     void Flush();
 
     void Step();
@@ -49,7 +187,8 @@ private:
         const int ab, const int bc, const int ca,
         int e);
 
-    void Legalize(const int a);
+    void BeforeCollinearSplit(const int t);
+    void BeforeFlip(const int t0, const int t1);
 
     void QueuePush(const int t);
     int QueuePop();
@@ -72,6 +211,8 @@ private:
     std::vector<int> m_QueueIndexes;
     std::vector<int> m_Queue;
     std::vector<int> m_Pending;
+    // a halfedge on the hull, kept by Flush
+    int m_HullEdge = -1;
 
     std::vector<glm::ivec2> m_PointsTmp;
     std::vector<int> m_TrianglesTmp;
@@ -81,11 +222,44 @@ private:
     std::vector<int> m_QueueIndexesTmp;
     std::vector<int> m_QueueTmp;
     std::vector<int> m_PendingTmp;
+    int m_HullEdgeTmp = -1;
 
     std::vector<int> m_MorphTarget;
     std::vector<int> m_MorphTargetTmp;
 
+    std::vector<int> m_SplitTriangles;
+    std::vector<int> m_SplitTrianglesTmp;
+
+    std::vector<float> m_InsertionErrors;
+    std::vector<float> m_InsertionErrorsTmp;
+
+    // unscaled morphed positions plus the children of each point, linked through
+    // m_MorphSibling in insertion order. rebuilt whenever the point count changes
+    std::vector<glm::vec3> m_MorphPoints;
+    std::vector<int> m_MorphChild;
+    std::vector<int> m_MorphSibling;
+    std::vector<int> m_MorphStack;
+    float m_MorphCutoff = 0;
+    float m_MorphWindow = 0.05f;
+    float m_MorphWindowPoints = 0;
+
     const float m_MaxError;
     const int m_MaxTriangles;
     const int m_MaxPoints;
+
+    int m_Threads = 1;
+    bool m_Deterministic = false;
+
+    TriangulatorStats m_Stats;
+
+    uint64_t m_Revision = 0;
+    bool m_TrackChanges = false;
+    std::vector<int> m_Changed;
+    std::vector<uint8_t> m_ChangedFlags;
 };
+
+// run a full triangulation in deterministic mode with 1..maxThreads threads
+// and check that every run produces the same Checksum()
+bool VerifyDeterminism(
+    const std::shared_ptr<Heightmap>& heightmap,
+    float error, int nTri, int nVert, int maxThreads);
@@ -0,0 +1,30 @@
+#include "test.h"
+
+std::vector<TestCase>& TestCases()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+int& TestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+int main()
+{
+    int failed = 0;
+    for (const TestCase& test : TestCases())
+    {
+        const int before = TestFailures();
+        std::printf("%s\n", test.Name);
+        test.Fn();
+        if (TestFailures() != before)
+        {
+            failed++;
+        }
+    }
+    std::printf("%d of %d tests failed\n", failed, static_cast<int>(TestCases().size()));
+    return failed == 0 ? 0 : 1;
+}
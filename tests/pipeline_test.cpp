@@ -0,0 +1,77 @@
+#include "test.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "pipeline.h"
+
+namespace
+{
+    // several chunks of a pipeline pass, with NaNs at the start and inside
+    std::vector<float> Fixture(const int w, const int h)
+    {
+        std::vector<float> data(w * h);
+        uint32_t s = 1;
+        for (float& v : data)
+        {
+            s = s * 1103515245u + 12345u;
+            v = ((s >> 8) & 65535) / 65535.f * 0.6f + 0.2f;
+        }
+        data[0] = NAN;
+        data[data.size() / 2] = NAN;
+        return data;
+    }
+
+    bool SameBits(const Heightmap& a, const Heightmap& b)
+    {
+        if (a.Width() != b.Width() || a.Height() != b.Height())
+        {
+            return false;
+        }
+        for (int y = 0; y < a.Height(); ++y)
+        {
+            for (int x = 0; x < a.Width(); ++x)
+            {
+                const float u = a.At(x, y);
+                const float v = b.At(x, y);
+                if (std::memcmp(&u, &v, sizeof(float)) != 0)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+TEST(PipelineMatchesHeightmapOps)
+{
+    const int w = 300;
+    const int h = 200;
+    const std::vector<float> data = Fixture(w, h);
+
+    for (const bool nanFirst : { true, false })
+    {
+        std::vector<float> input = data;
+        if (!nanFirst)
+        {
+            input[0] = 0.5f;
+        }
+        Heightmap expected(w, h, input);
+        expected.Invert();
+        expected.AutoLevel();
+        expected.GammaCurve(2.2f);
+        expected.AutoLevel();
+
+        for (const int threads : { 1, 3, 8 })
+        {
+            Heightmap hm(w, h, input);
+            HeightmapPipeline pipeline;
+            pipeline.Invert().AutoLevel().GammaCurve(2.2f).AutoLevel();
+            pipeline.SetThreadCount(threads);
+            pipeline.Apply(hm);
+            CHECK(SameBits(hm, expected));
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#include "test.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#include "quantized.h"
+
+namespace
+{
+    // code c as every loader stores it
+    float FromCode(const uint16_t c)
+    {
+        return c * (1.f / 65535.f);
+    }
+}
+
+TEST(QuantizeMeshKeepsEveryCode)
+{
+    // four codes at a time on the corners of a 2 x 2 map, the only points before refining
+    int lossy = 0;
+    int wrong = 0;
+    for (int c = 0; c < 65536; c += 4)
+    {
+        const std::vector<float> data = {
+            FromCode(uint16_t(c)), FromCode(uint16_t(c + 1)),
+            FromCode(uint16_t(c + 2)), FromCode(uint16_t(c + 3)) };
+        Triangulator tri(std::make_shared<Heightmap>(2, 2, data), 0, 0, 0);
+        tri.Initialize();
+        const QuantizedMesh mesh = QuantizeMesh(tri, 1);
+        lossy += mesh.Scale.z != 1.f / 65535.f || mesh.Offset.z != 0;
+        for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+        {
+            const QuantizedVertex& v = mesh.Vertices[i];
+            wrong += v.Z != c + v.Y * 2 + v.X;
+        }
+    }
+    CHECK(lossy == 0);
+    CHECK(wrong == 0);
+}
+
+TEST(QuantizeMeshKeepsR16Codes)
+{
+    constexpr int Size = 256;
+    const auto code = [](const int i) { return uint16_t(i * 40503u); };
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::filesystem::path path = dir / "hmm_quantized_test.r16";
+    {
+        std::ofstream raw(path, std::ios::binary);
+        for (int i = 0; i < Size * Size; ++i)
+        {
+            const uint16_t c = code(i);
+            const char bytes[2] = { char(c & 0xff), char(c >> 8) };
+            raw.write(bytes, 2);
+        }
+        std::ofstream header(dir / "hmm_quantized_test.hdr");
+        header << "ncols " << Size << "\nnrows " << Size << "\nnbits 16\nbyteorder I\n";
+    }
+
+    const std::shared_ptr<Heightmap> hm = std::make_shared<Heightmap>(path.string());
+    CHECK(hm->Width() == Size && hm->Height() == Size);
+    CHECK(hm->Quantized());
+
+    Triangulator tri(hm, 0, 0, 0);
+    tri.Initialize();
+    tri.Run();
+    const QuantizedMesh mesh = QuantizeMesh(tri, 1);
+    CHECK(mesh.Scale.z == 1.f / 65535.f);
+    CHECK(mesh.Offset.z == 0);
+    int wrong = 0;
+    for (const QuantizedVertex& v : mesh.Vertices)
+    {
+        wrong += v.Z != code(v.Y * Size + v.X);
+    }
+    CHECK(wrong == 0);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(dir / "hmm_quantized_test.hdr");
+}
@@ -0,0 +1,115 @@
+#include "test.h"
+
+#include <cmath>
+
+#include "terrain.h"
+
+namespace
+{
+    constexpr float Pi = 3.14159265358979f;
+
+    bool Near(const float a, const float b, const float tolerance)
+    {
+        return std::abs(a - b) <= tolerance;
+    }
+
+    Heightmap Surface(const int w, const int h, float (*z)(int, int))
+    {
+        std::vector<float> data(w * h);
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                data[y * w + x] = z(x, y);
+            }
+        }
+        return Heightmap(w, h, data);
+    }
+}
+
+TEST(TerrainDerivativesOfPlane)
+{
+    // rises 0.3 per pixel east (+x) and 0.4 per pixel south (+y)
+    const int w = 16;
+    const int h = 12;
+    const Heightmap hm = Surface(w, h, [](const int x, const int y) { return 0.3f * x + 0.4f * y; });
+
+    TerrainOptions options;
+    options.ZScale = 2;
+    options.Slope = true;
+    options.Aspect = true;
+    options.ProfileCurvature = true;
+    options.PlanCurvature = true;
+    const TerrainDerivatives d = ComputeTerrainDerivatives(hm, options);
+    CHECK(d.Width == w && d.Height == h);
+
+    // gradient (0.6, 0.8), downhill points north and west of it
+    const float slope = std::atan(1.f);
+    const float aspect = 2 * Pi - std::atan(0.6f / 0.8f);
+    int wrong = 0;
+    for (int y = 1; y < h - 1; ++y)
+    {
+        for (int x = 1; x < w - 1; ++x)
+        {
+            const int i = y * w + x;
+            wrong += !Near(d.Slope[i], slope, 1e-5f);
+            wrong += !Near(d.Aspect[i], aspect, 1e-5f);
+            wrong += !Near(d.ProfileCurvature[i], 0, 1e-5f);
+            wrong += !Near(d.PlanCurvature[i], 0, 1e-5f);
+        }
+    }
+    CHECK(wrong == 0);
+}
+
+TEST(TerrainDerivativesOfParaboloid)
+{
+    // z = c * rho^2 around the center pixel, rho the distance to it
+    const int size = 33;
+    const int center = size / 2;
+    const float c = 0.01f;
+    const Heightmap hm = Surface(size, size, [](const int x, const int y)
+    {
+        const float dx = float(x - size / 2);
+        const float dy = float(y - size / 2);
+        return dx * dx + dy * dy;
+    });
+
+    TerrainOptions options;
+    options.ZScale = c;
+    options.Slope = true;
+    options.Aspect = true;
+    options.ProfileCurvature = true;
+    options.PlanCurvature = true;
+    const TerrainDerivatives d = ComputeTerrainDerivatives(hm, options);
+
+    int wrong = 0;
+    for (int y = 1; y < size - 1; ++y)
+    {
+        for (int x = 1; x < size - 1; ++x)
+        {
+            const int i = y * size + x;
+            const float dx = float(x - center);
+            const float dy = float(y - center);
+            const float rho = std::sqrt(dx * dx + dy * dy);
+            if (rho == 0)
+            {
+                // the flat bottom has no direction
+                wrong += d.Slope[i] != 0 || d.Aspect[i] != -1;
+                wrong += d.ProfileCurvature[i] != 0 || d.PlanCurvature[i] != 0;
+                continue;
+            }
+
+            // the gradient 2 c rho points away from the center, downhill towards it.
+            // along the slope the surface bends up by 2c over the arc length, across
+            // it the contour is a circle of radius rho around the center
+            const float gradient = 2 * c * rho;
+            float aspect = std::atan2(-dx, dy);
+            aspect = aspect < 0 ? aspect + 2 * Pi : aspect;
+            wrong += !Near(d.Slope[i], std::atan(gradient), 1e-5f);
+            wrong += !Near(d.Aspect[i], aspect, 1e-5f);
+            wrong += !Near(d.ProfileCurvature[i], -2 * c / std::pow(1 + gradient * gradient, 1.5f), 1e-5f);
+            wrong += !Near(d.PlanCurvature[i], -1 / rho, 1e-4f);
+        }
+    }
+    CHECK(wrong == 0);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// minimal self-registering tests, run in order of registration by main.cpp.
+// a failed CHECK is reported and counted, and the test carries on
+struct TestCase
+{
+    const char* Name;
+    void (*Fn)();
+};
+
+std::vector<TestCase>& TestCases();
+
+int& TestFailures();
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* name, void (*fn)())
+    {
+        TestCases().push_back({ name, fn });
+    }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static const TestRegistrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            TestFailures()++; \
+        } \
+    } while (0)
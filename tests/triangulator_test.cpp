@@ -0,0 +1,66 @@
+#include "test.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "triangulator.h"
+
+namespace
+{
+    uint32_t Hash(uint32_t x, uint32_t y)
+    {
+        uint32_t h = x * 374761393u + y * 668265263u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        return h ^ (h >> 16);
+    }
+
+    // value noise built from integer math only, so every compiler and libm
+    // produces the same 16-bit codes
+    std::shared_ptr<Heightmap> Fixture(const int w, const int h)
+    {
+        constexpr int Cell = 32;
+        std::vector<float> data(size_t(w) * h);
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                const uint32_t cx = x / Cell;
+                const uint32_t cy = y / Cell;
+                const uint32_t fx = x % Cell;
+                const uint32_t fy = y % Cell;
+                const uint64_t c00 = Hash(cx, cy) & 0xffff;
+                const uint64_t c10 = Hash(cx + 1, cy) & 0xffff;
+                const uint64_t c01 = Hash(cx, cy + 1) & 0xffff;
+                const uint64_t c11 = Hash(cx + 1, cy + 1) & 0xffff;
+                const uint64_t top = c00 * (Cell - fx) + c10 * fx;
+                const uint64_t bottom = c01 * (Cell - fx) + c11 * fx;
+                const uint32_t code = uint32_t((top * (Cell - fy) + bottom * fy) / (Cell * Cell));
+                data[size_t(y) * w + x] = code * (1.f / 65535.f);
+            }
+        }
+        return std::make_shared<Heightmap>(w, h, data);
+    }
+
+    // Checksum() of the fixture below, pinned so a change in refinement order
+    // shows up even when every thread count agrees with the others
+    constexpr uint64_t FixtureChecksum = 0xdab0637cf74cb573ull;
+}
+
+TEST(TriangulatorDeterministicAcrossThreadCounts)
+{
+    // the first flushes cover the whole 512 x 512 map, far above the parallel threshold
+    const std::shared_ptr<Heightmap> hm = Fixture(512, 512);
+    for (const int threads : { 1, 2, 3, 4, 8 })
+    {
+        Triangulator tri(hm, 0.002f, 0, 0);
+        tri.SetThreadCount(threads);
+        tri.SetDeterministic(true);
+        tri.Initialize();
+        tri.Run();
+        CHECK(tri.Checksum() == FixtureChecksum);
+#if HMM_ENABLE_STATS
+        CHECK(threads == 1 || tri.Stats().ParallelFlushes > 0);
+#endif
+    }
+    CHECK(VerifyDeterminism(hm, 0.002f, 0, 0, 8));
+}